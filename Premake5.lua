@@ -1,5 +1,5 @@
 workspace "Computer graphics in Game development"
-    configurations { "Debug", "Release" }
+    configurations { "Debug", "Release", "Scalar" }
     language "C++"
     cppdialect "C++17"
     architecture "x64"
@@ -16,6 +16,11 @@ workspace "Computer graphics in Game development"
     filter("configurations:Release")
         defines({ "NDEBUG" })
         symbols("On")
+    -- Release with the scalar rasterizer kernels instead of the SSE ones,
+    -- removed from the projects which don't build the rasterizer
+    filter("configurations:Scalar")
+        defines({ "NDEBUG", "CG_RASTERIZER_SCALAR" })
+        symbols("On")
 
 project "01. Rasterization"
     kind "ConsoleApp"
@@ -99,6 +104,7 @@ group ""
 
 project "02. Ray tracing"
     kind "ConsoleApp"
+    removeconfigurations { "Scalar" }
     defines { "RAYTRACING" }
     includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
     includedirs { "src" }
@@ -115,6 +121,7 @@ project "02. Ray tracing"
 group "Tests"
     project "Test 06. Camera ray generation"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "RAYTRACING" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -124,6 +131,7 @@ group "Tests"
 
     project "Test 07. Ray-triangle intersection"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "RAYTRACING" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -133,6 +141,7 @@ group "Tests"
 
     project "Test 08. Lambertian shading"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "RAYTRACING" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -142,6 +151,7 @@ group "Tests"
 
     project "Test 09. Shadow rays"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "RAYTRACING" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -151,6 +161,7 @@ group "Tests"
 
     project "Test 10. Acceleraction structure benchmark"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "RAYTRACING" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -162,6 +173,7 @@ group ""
 
 project "03. DirectX 12"
     kind "WindowedApp"
+    removeconfigurations { "Scalar" }
     defines { "DX12" }
     entrypoint "WinMainCRTStartup"
     links { "d3d12", "dxgi", "d3dcompiler" }
@@ -182,6 +194,7 @@ project "03. DirectX 12"
 group "Tests"
     project "Test 11. DX12 camera"
         kind "ConsoleApp"
+        removeconfigurations { "Scalar" }
         defines { "DX12" }
         includedirs { "libs/Catch2/single_include/catch2" }
         includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
@@ -189,4 +202,202 @@ group "Tests"
         links { "Static" }
         files { "tests/dx12/dx12_camera_test.cpp" }
 
+    project "Test 12. Tiled rasterization"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/tiled_rasterization_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 13. Fill rule"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/fill_rule_test.cpp" }
+
+    project "Test 14. Hierarchical depth buffer"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/hierarchical_z_test.cpp" }
+
+    project "Test 15. Depth pre-pass"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/depth_prepass_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 16. Indexed draw"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/indexed_draw_test.cpp" }
+
+    project "Test 17. Shader binding benchmark"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/shader_binding_benchmark_test.cpp" }
+
+    project "Test 18. Clipping"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/clipping_test.cpp" }
+
+    project "Test 19. Face culling"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/face_culling_test.cpp" }
+
+    project "Test 20. Visibility buffer"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/visibility_buffer_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 21. Perspective correction"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/perspective_correction_test.cpp" }
+
+    project "Test 22. Vertex layout"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/vertex_layout_test.cpp" }
+
+    project "Test 23. Compact vertex"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/compact_vertex_test.cpp" }
+
+    project "Test 24. MSAA"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/msaa_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 25. Fast clear"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/fast_clear_test.cpp" }
+
+    project "Test 26. Command list"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/command_list_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 27. Primitive topology"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/primitive_topology_test.cpp" }
+
+    project "Test 28. Occlusion query"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/occlusion_query_test.cpp" }
+
+    project "Test 29. Tiled targets"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/tiled_targets_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 30. Frame arena"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/frame_arena_test.cpp" }
+
+    project "Test 31. HDR target"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/hdr_target_test.cpp" }
+
+    project "Test 32. Vertex processing"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/vertex_processing_test.cpp", "tests/rasterization/random_scene.h" }
+
+    project "Test 33. Coverage"
+        kind "ConsoleApp"
+        defines { "RASTERIZATION" }
+        includedirs { "libs/Catch2/single_include/catch2" }
+        includedirs { "libs/stb", "libs/tinyobjloader", "libs/linalg", "libs/cxxopts/include" }
+        includedirs { "src" }
+        links { "Static" }
+        files { "tests/rasterization/coverage_test.cpp", "tests/rasterization/random_scene.h" }
+
 group ""
\ No newline at end of file
@@ -1,216 +1,2782 @@
 #pragma once
 
 #include "resource.h"
+#include "utils/simd.h"
 
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <iostream>
 #include <linalg.h>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 
 using namespace linalg::aliases;
 
 namespace cg::renderer
 {
+// Shaders are template parameters, so functor types are inlined into the
+// hot loops. The std::function defaults keep the assignable shader API.
+template<typename VB>
+using vertex_shader_function = std::function<std::pair<float4, VB>(float4 vertex, VB vertex_data)>;
+template<typename VB>
+using pixel_shader_function =
+	std::function<cg::color(const cg::decoded_vertex_t<VB>& vertex_data, const float z)>;
+
+// A pixel shader may declare the attributes it reads, e.g.
+// using attributes = cg::attribute_list<&cg::vertex::nx, &cg::vertex::ny>;
+// The rest of the attributes are zero in the interpolated vertex.
+template<typename VB, typename PS, typename = void>
+struct shader_attributes
+{
+	using type = typename cg::vertex_layout<VB>::attributes;
+};
+
+template<typename VB, typename PS>
+struct shader_attributes<VB, PS, std::void_t<typename PS::attributes>>
+{
+	using type = typename PS::attributes;
+};
+
+// Position of the interpolated vertex is the pixel and its depth, an
+// encoded normal is interpolated decoded
+template<typename VB, typename M>
+constexpr bool is_encoded_normal(M in_member)
+{
+	if constexpr (cg::has_encoded_normal_v<VB>)
+		return cg::vertex_layout<VB>::normal::contains(in_member);
+	else
+		return false;
+}
+
+template<typename VB, typename M>
+constexpr bool is_interpolated(M in_member)
+{
+	if constexpr (std::is_same_v<M, float VB::*>)
+		return in_member != &VB::x && in_member != &VB::y && in_member != &VB::z &&
+			   !is_encoded_normal<VB>(in_member);
+	else
+		return false;
+}
+
+template<typename VB, auto... Members>
+constexpr bool reads_encoded_normal(cg::attribute_list<Members...>)
+{
+	return (is_encoded_normal<VB>(Members) || ... || false);
+}
+
+template<typename VB, auto... Members>
+constexpr size_t count_interpolated(cg::attribute_list<Members...>)
+{
+	return (size_t(is_interpolated<VB>(Members)) + ... + size_t(0));
+}
+
+template<typename VB, size_t N, auto... Members>
+constexpr std::array<float VB::*, N> get_interpolated(cg::attribute_list<Members...>)
+{
+	std::array<float VB::*, N> members{};
+	size_t count = 0;
+	auto add = [&](auto member) {
+		if constexpr (std::is_same_v<decltype(member), float VB::*>)
+		{
+			if (is_interpolated<VB>(member))
+				members[count++] = member;
+		}
+	};
+	(add(Members), ...);
+	return members;
+}
+
+// Float attributes of VB which are interpolated for PS
+template<typename VB, typename PS>
+struct interpolation_layout
+{
+	using attributes = typename shader_attributes<VB, PS>::type;
+	static constexpr int num_interpolated =
+		static_cast<int>(count_interpolated<VB>(attributes{}));
+	static constexpr std::array<float VB::*, num_interpolated> members =
+		get_interpolated<VB, num_interpolated>(attributes{});
+	// Planes of the decoded normal follow the members, the last plane is 1/w
+	static constexpr bool decoded_normal = reads_encoded_normal<VB>(attributes{});
+	static constexpr int normal_plane = num_interpolated;
+	static constexpr int inv_w_plane = num_interpolated + (decoded_normal ? 3 : 0);
+	static constexpr int num_planes = inv_w_plane + 1;
+};
+
+// Rasterizers over other types, like rasterizer<float, unsigned char>, only
+// clear their targets, so resolve doesn't instantiate the shading for them
+template<typename VB, typename RT, typename = void>
+struct can_draw : std::false_type
+{
+};
+
 template<typename VB, typename RT>
+struct can_draw<VB, RT, std::void_t<typename cg::vertex_layout<VB>::attributes, decltype(RT::r)>>
+	: std::true_type
+{
+};
+
+// Triangles of a strip share two vertices with the previous one, and every
+// odd triangle swaps its first two vertices to keep the winding. Triangles
+// of a fan share the first vertex of the draw.
+enum class primitive_topology
+{
+	triangle_list,
+	triangle_strip,
+	triangle_fan
+};
+
+// Id of an occlusion query which is not set
+constexpr size_t no_query = SIZE_MAX;
+
+// Draws recorded with their bindings and executed later by
+// rasterizer::execute. Shaders are copied, so the constants they capture are
+// recorded per draw too. Vertex shaders run concurrently on execution if
+// the rasterizer processes vertices in parallel.
+template<
+	typename VB, typename VS = vertex_shader_function<VB>,
+	typename PS = pixel_shader_function<VB>>
+class command_list
+{
+public:
+	command_list(){};
+	command_list(VS in_vertex_shader, PS in_pixel_shader) :
+	vertex_shader(in_vertex_shader), pixel_shader(in_pixel_shader){};
+
+	struct draw_command
+	{
+		VS vertex_shader;
+		PS pixel_shader;
+		std::shared_ptr<resource<VB>> vertex_buffer;
+		std::shared_ptr<resource<uint32_t>> index_buffer;
+		primitive_topology topology;
+		size_t count;
+		size_t offset;
+		bool indexed;
+		bool opaque;
+		bool color_write;
+		bool depth_write;
+		size_t query;
+		size_t predicate;
+	};
+
+	void set_vertex_buffer(std::shared_ptr<resource<VB>> in_vertex_buffer);
+	void set_index_buffer(std::shared_ptr<resource<uint32_t>> in_index_buffer);
+
+	void draw(size_t num_vertexes, size_t vertex_offset);
+	void draw_indexed(size_t num_indexes, size_t index_offset);
+
+	// Samples which pass the depth test in the draws between begin_query and
+	// end_query are counted into the query on execution. Draws after
+	// set_predicate are skipped if the query counted nothing.
+	void begin_query(size_t in_query);
+	void end_query();
+	void set_predicate(size_t in_query);
+
+	// Drops the recorded draws, the storage is reused by the next frame
+	void reset();
+	const std::vector<draw_command>& get_commands() const;
+
+	VS vertex_shader;
+	PS pixel_shader;
+	primitive_topology topology = primitive_topology::triangle_list;
+	// Opaque draws are reordered front-to-back, the rest keep their order
+	// and run after them
+	bool opaque = true;
+	bool color_write = true;
+	bool depth_write = true;
+
+protected:
+	std::shared_ptr<resource<VB>> vertex_buffer;
+	std::shared_ptr<resource<uint32_t>> index_buffer;
+	size_t query = no_query;
+	size_t predicate = no_query;
+	std::vector<draw_command> commands;
+
+	void record_draw(size_t count, size_t offset, bool indexed);
+};
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::set_vertex_buffer(std::shared_ptr<resource<VB>> in_vertex_buffer)
+{
+	vertex_buffer = in_vertex_buffer;
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::set_index_buffer(
+	std::shared_ptr<resource<uint32_t>> in_index_buffer)
+{
+	index_buffer = in_index_buffer;
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::draw(size_t num_vertexes, size_t vertex_offset)
+{
+	record_draw(num_vertexes, vertex_offset, false);
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::draw_indexed(size_t num_indexes, size_t index_offset)
+{
+	record_draw(num_indexes, index_offset, true);
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::begin_query(size_t in_query)
+{
+	if (in_query == no_query)
+		THROW_ERROR("Query id is not valid");
+	query = in_query;
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::end_query()
+{
+	query = no_query;
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::set_predicate(size_t in_query)
+{
+	predicate = in_query;
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::record_draw(size_t count, size_t offset, bool indexed)
+{
+	commands.push_back(draw_command{ vertex_shader, pixel_shader, vertex_buffer, index_buffer,
+									 topology, count, offset, indexed, opaque, color_write,
+									 depth_write, query, predicate });
+}
+
+template<typename VB, typename VS, typename PS>
+inline void command_list<VB, VS, PS>::reset()
+{
+	commands.clear();
+}
+
+template<typename VB, typename VS, typename PS>
+inline const std::vector<typename command_list<VB, VS, PS>::draw_command>&
+	command_list<VB, VS, PS>::get_commands() const
+{
+	return commands;
+}
+
+// Render targets of cg::unsigned_color are written per fragment. Float
+// targets of cg::color keep the results of the pixel shader as they are,
+// for a resolve pass after all of the draws, see tone_mapping.h.
+template<
+	typename VB, typename RT, typename VS = vertex_shader_function<VB>,
+	typename PS = pixel_shader_function<VB>>
 class rasterizer
 {
 public:
 	rasterizer(){};
+	rasterizer(VS in_vertex_shader, PS in_pixel_shader) :
+	vertex_shader(in_vertex_shader), pixel_shader(in_pixel_shader){};
 	~rasterizer(){};
 	void set_render_target(
 		std::shared_ptr<resource<RT>> in_render_target,
 		std::shared_ptr<resource<float>> in_depth_buffer = nullptr);
 	void clear_render_target(const RT& in_clear_value, const float in_depth = FLT_MAX);
+	// Writes the clear values to the tiles which are still cleared lazily,
+	// before the render target or the depth buffer is read outside
+	void resolve_clear();
+	// End of the frame: shades the pixels of the visibility buffer, then
+	// averages the samples which the draws wrote since the last resolve into
+	// the render target. Called once after all of the draws.
+	void resolve();
 
 	void set_vertex_buffer(std::shared_ptr<resource<VB>> in_vertex_buffer);
+	void set_index_buffer(std::shared_ptr<resource<uint32_t>> in_index_buffer);
 
 	void set_viewport(size_t in_width, size_t in_height);
 
+	// Scratch data of a draw call or a command list is taken from the arena
+	// and released when it returns, so draws reuse the same memory. The
+	// arena may be shared, e.g. with the model loader or by the frames of a
+	// renderer. Copies of the rasterizer share it too.
+	void set_arena(std::shared_ptr<cg::frame_arena> in_arena);
+	std::shared_ptr<cg::frame_arena> get_arena() const;
+
 	void draw(size_t num_vertexes, size_t vertex_offset);
+	// Every vertex referenced by the indices is shaded once per draw call
+	void draw_indexed(size_t num_indexes, size_t index_offset);
+	// Sets up the draws, then rasterizes the opaque ones sorted by their
+	// nearest depth, so the farther ones are rejected early. With
+	// parallel_vertex_processing the draws are set up in parallel, so the
+	// vertex shaders of the list have to be thread-safe.
+	// Statistics are summed over the list, the bindings of the rasterizer
+	// are kept. Queries of the list start from zero, a draw predicated on
+	// one of them runs right after the draws counted into it and is set up
+	// only if they passed. The query and the predicate of the rasterizer
+	// don't apply to the list.
+	void execute(const command_list<VB, VS, PS>& in_command_list);
+
+	// Occlusion query: counts the samples which pass the depth test in the
+	// draws until end_query. While a predicate is set, draws are skipped if
+	// its query counted nothing, no_query draws unconditionally. Queries
+	// which were never begun don't skip anything.
+	void begin_query(size_t in_query);
+	void end_query();
+	size_t get_query_result(size_t in_query) const;
+	void set_predicate(size_t in_query);
 
-	std::function<std::pair<float4, VB>(float4 vertex, VB vertex_data)> vertex_shader;
-	std::function<cg::color(const VB& vertex_data, const float z)> pixel_shader;
+	VS vertex_shader;
+	PS pixel_shader;
 	bool smooth_shading = true;
+	primitive_topology topology = primitive_topology::triangle_list;
+
+	// Vertices are processed and triangles are set up in chunks in parallel.
+	// The vertex shader has to be thread-safe.
+	bool parallel_vertex_processing = false;
+
+	// Sort-middle mode: triangles are binned into screen tiles and the tiles
+	// are rasterized in parallel. The pixel shader has to be thread-safe.
+	bool tiled_rasterization = false;
+	size_t tile_size = 64;
+
+	// Rejects 8x8 tiles of a triangle which are behind the farthest depth of
+	// the tile before its pixels are tested
+	bool hierarchical_z = true;
+
+	// Draws depth only first, then shades the fragments with equal depth, so
+	// the pixel shader runs once per visible pixel. Requires a depth buffer.
+	bool depth_prepass = false;
+
+	// Rasterization writes only the id of the nearest primitive and its depth,
+	// then resolve shades every covered pixel once over all of the draws.
+	// Primitives and pixel shaders of the draws are kept until then. Draws
+	// which write colors otherwise, including draws of more primitives than
+	// the ids hold, and the 1024th draw, resolve the pending ones first.
+	// Resolve shades rows in parallel, so the pixel shader has to be
+	// thread-safe. Requires a depth buffer.
+	bool visibility_buffer = false;
+	static constexpr uint32_t empty_primitive_id = UINT32_MAX;
+	// Ids hold the draw since the last resolve in the upper bits and the
+	// primitive of the draw call in the lower ones. They stay in the buffer
+	// until the next draw after the resolve.
+	static constexpr int visibility_primitive_bits = 22;
+	std::shared_ptr<cg::resource<uint32_t>> get_visibility_buffer() const;
+
+	// Multisampling with 1, 2, 4 or 8 samples per pixel. Depth is tested per
+	// sample and the samples of a pixel are adjacent in the depth buffer, so
+	// it is sample_count times wider than the viewport, as the visibility
+	// buffer is. The pixel shader runs once per pixel and triangle, and the
+	// samples are averaged into the render target by resolve.
+	unsigned sample_count = 1;
+
+	// Clearing only marks the 8x8 depth tiles as cleared, a tile is filled
+	// when a draw call touches it first. Requires a depth buffer, the render
+	// target is complete after resolve_clear.
+	bool fast_clear = false;
+
+	// Pixels are traversed in 8x8 tiles. Tiled render targets and depth
+	// buffers should have tiles of a multiple of it, with all of the samples
+	// of a pixel, so every tile of the rasterizer is contiguous in memory.
+	static constexpr size_t target_tile_size = 8;
+
+	// Draws with both writes off only test depth, e.g. the proxies of
+	// occlusion queries
+	bool color_write = true;
+	bool depth_write = true;
+
+	// Triangles which are counter-clockwise in normalized device coordinates
+	// are front-facing
+	enum class cull_mode
+	{
+		none,
+		back,
+		front
+	};
+	cull_mode face_culling = cull_mode::back;
+
+	struct draw_statistics
+	{
+		// Every submitted triangle is either culled, clipped or rasterized as is.
+		// Clipped triangles are rasterized as one or more parts.
+		size_t submitted_triangles = 0;
+		size_t culled_triangles = 0;
+		size_t clipped_triangles = 0;
+		size_t rasterized_triangles = 0;
+		size_t tested_tiles = 0;
+		size_t culled_tiles = 0;
+		size_t shaded_fragments = 0;
+		// Samples which passed the depth test, the depth-equal pass of the
+		// pre-pass isn't counted
+		size_t passed_samples = 0;
+		// Draws skipped by their predicate
+		size_t skipped_draws = 0;
+
+		draw_statistics& operator+=(const draw_statistics& other)
+		{
+			submitted_triangles += other.submitted_triangles;
+			culled_triangles += other.culled_triangles;
+			clipped_triangles += other.clipped_triangles;
+			rasterized_triangles += other.rasterized_triangles;
+			tested_tiles += other.tested_tiles;
+			culled_tiles += other.culled_tiles;
+			shaded_fragments += other.shaded_fragments;
+			passed_samples += other.passed_samples;
+			skipped_draws += other.skipped_draws;
+			return *this;
+		}
+	};
+	// Statistics of the last draw call, resolve adds the fragments shaded
+	// from the visibility buffer
+	const draw_statistics& get_statistics() const;
 
 protected:
+	// E(x, y) = c + x * step_x + y * step_y in squared sub-pixel units
+	struct edge_equation
+	{
+		int64_t c;
+		int32_t step_x;
+		int32_t step_y;
+		// -1 for edges which are not top or left, so the pixels on them are
+		// owned by the neighbour triangle
+		int32_t bias;
+	};
+
+	// Attributes over w and 1/w are linear in screen space, so they are
+	// interpolated as planes and divided per pixel:
+	// value(x, y) = origin + (x - x0) * step_x + (y - y0) * step_y, where
+	// (x0, y0) is the beginning of the bounding box
+	using layout = interpolation_layout<VB, PS>;
+
+	struct attribute_plane
+	{
+		float origin;
+		float step_x;
+		float step_y;
+	};
+
+	struct primitive
+	{
+		VB vertices[3];
+		float inv_w[3];
+		attribute_plane planes[layout::num_planes];
+		float edge;
+		edge_equation edges[3];
+		int2 bounding_box_begin;
+		int2 bounding_box_end;
+		float depth_min;
+		float depth_max;
+		bool visible;
+		uint32_t id;
+	};
+
+	// Positions of a vertex range, one array per component: clip space is
+	// kept for the clipper next to the projected screen space
+	struct vertex_positions
+	{
+		vertex_positions(std::pmr::memory_resource* in_arena) :
+		x(in_arena), y(in_arena), z(in_arena), w(in_arena), screen_x(in_arena),
+		screen_y(in_arena), screen_z(in_arena){};
+
+		size_t first_vertex;
+		std::pmr::vector<float> x;
+		std::pmr::vector<float> y;
+		std::pmr::vector<float> z;
+		std::pmr::vector<float> w;
+		std::pmr::vector<float> screen_x;
+		std::pmr::vector<float> screen_y;
+		std::pmr::vector<float> screen_z;
+	};
+
+	// Scratch containers of a draw call, allocated from the arena
+	using primitive_list = std::pmr::vector<primitive>;
+
+	// Bindings which the setup of a draw reads, so the draws of a command
+	// list are set up in parallel without changing the rasterizer. Buffers
+	// are read through their storage, the range of the draw is checked once
+	// before its setup.
+	struct draw_bindings
+	{
+		const VS* vertex_shader;
+		span<VB> vertices;
+		span<uint32_t> indices;
+		primitive_topology topology;
+		// Vertices and triangles of the draw are processed in parallel
+		bool parallel;
+	};
+	using bin_list = std::pmr::vector<std::pmr::vector<int>>;
+
+	struct clip_vertex
+	{
+		float4 position;
+		VB data;
+	};
+
+	// Outcode bits, one per clipping plane
+	enum clip_plane : unsigned
+	{
+		clip_near = 1,
+		clip_far = 2,
+		clip_left = 4,
+		clip_right = 8,
+		clip_bottom = 16,
+		clip_top = 32
+	};
+
+	enum class raster_pass
+	{
+		color,
+		depth_only,
+		depth_equal,
+		visibility
+	};
+
+	// Vertices are snapped to 1/16 of a pixel. Triangles are clipped to the
+	// guard band, which keeps the edge steps of a block in 32 bits.
+	static constexpr int subpixel_bits = 4;
+	static constexpr int64_t subpixel_scale = int64_t(1) << subpixel_bits;
+	static constexpr float guard_band = 16384.f;
+
+	// Near plane and guard band add at most one vertex each
+	static constexpr int max_clipped_vertices = 8;
+
+	// Vertices are shaded and projected in chunks
+	static constexpr int vertex_chunk_size = 256;
+
+	// Pixels are tested in 4x4 blocks, one bit of a coverage mask per pixel
+	static constexpr int block_size = 4;
+	static constexpr unsigned full_coverage = 0xFFFF;
+
+	// Standard sample positions in sub-pixel units around the pixel, for 1,
+	// 2, 4 and 8 samples
+	static constexpr int max_samples = 8;
+	static constexpr int sample_positions[4][max_samples][2] = {
+		{ { 0, 0 } },
+		{ { 4, 4 }, { -4, -4 } },
+		{ { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } },
+		{ { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } }
+	};
+
 	std::shared_ptr<cg::resource<VB>> vertex_buffer;
+	std::shared_ptr<cg::resource<uint32_t>> index_buffer;
+	std::shared_ptr<cg::frame_arena> arena = std::make_shared<cg::frame_arena>();
 	std::shared_ptr<cg::resource<RT>> render_target;
 	std::shared_ptr<cg::resource<float>> depth_buffer;
+	std::shared_ptr<cg::resource<uint32_t>> primitive_ids;
+	// Colors per sample, adjacent as in the depth buffer
+	std::shared_ptr<cg::resource<RT>> color_samples;
+	// Union of the draws since the last resolve, empty if begin > end
+	int2 unresolved_begin{ INT_MAX, INT_MAX };
+	int2 unresolved_end{ -1, -1 };
+	// Set by the draws and cleared by resolve
+	bool pending_draws = false;
+
+	// Draws of the visibility buffer since the last resolve. The storage is
+	// created by the first draw and reused by the next frames.
+	struct visibility_draw
+	{
+		size_t first_primitive;
+		PS pixel_shader;
+	};
+	struct visibility_batch;
+	static constexpr size_t max_visibility_draws =
+		(size_t(1) << (32 - visibility_primitive_bits)) - 1;
+	std::shared_ptr<visibility_batch> pending_visibility;
+	size_t num_visibility_draws = 0;
+	// Draw bits of the ids which the visibility pass writes
+	uint32_t visibility_draw_id = 0;
+	// Union of the draws with ids in the buffer, cleared before the first
+	// draw after a resolve
+	int2 visibility_begin{ INT_MAX, INT_MAX };
+	int2 visibility_end{ -1, -1 };
+
+	// Farthest depth per tile and the number of its samples at that depth.
+	// Writes only bring depths nearer, so the farthest depth holds until the
+	// last of those samples is written, and the tile is scanned again when
+	// it's next tested. A count of zero marks a tile to scan.
+	static constexpr int depth_tile_size = static_cast<int>(target_tile_size);
+	std::shared_ptr<cg::resource<float>> depth_tiles;
+	std::shared_ptr<cg::resource<uint32_t>> depth_tiles_farthest;
+	// Tiles which hold stale data and are logically at the clear values
+	std::shared_ptr<cg::resource<unsigned char>> depth_tiles_cleared;
+	RT clear_value{};
+	float clear_depth = FLT_MAX;
+
+	// Unchecked views of the resources above, bound again whenever one of
+	// them is replaced
+	resource_view<RT> render_target_view;
+	resource_view<float> depth_buffer_view;
+	resource_view<uint32_t> primitive_ids_view;
+	resource_view<RT> color_samples_view;
+	resource_view<float> depth_tiles_view;
+	resource_view<uint32_t> depth_tiles_farthest_view;
+	resource_view<unsigned char> depth_tiles_cleared_view;
+	void bind_views();
+	draw_statistics statistics;
+	raster_pass pass = raster_pass::color;
+
+	// Passed samples per query
+	std::vector<size_t> query_results;
+	size_t active_query = no_query;
+	size_t predicate = no_query;
 
 	size_t width = 1920;
 	size_t height = 1080;
 
-	float edge_function(float2 a, float2 b, float2 c);
+	void submit_draw(size_t count, size_t offset, bool indexed);
+	bool is_occluded(size_t in_query) const;
+	draw_bindings get_bindings() const;
+	static draw_bindings get_bindings(
+		const VS& in_vertex_shader, resource<VB>* in_vertex_buffer,
+		resource<uint32_t>* in_index_buffer, primitive_topology in_topology, bool in_parallel);
+	// Vertices which a draw references
+	struct vertex_range
+	{
+		size_t first = 0;
+		size_t count = 0;
+	};
+	// Throws if the draw reads outside of its buffers, so the setup which
+	// runs in parallel doesn't
+	static vertex_range get_vertex_range(
+		const draw_bindings& in_bindings, size_t count, size_t offset, bool indexed);
+	// Triangle counts of the statistics are assigned
+	primitive_list setup_draw(
+		const draw_bindings& in_bindings, size_t count, size_t offset, bool indexed,
+		const vertex_range& in_range, draw_statistics& out_statistics);
+	static size_t get_num_primitives(primitive_topology in_topology, size_t count);
+	static size_t get_vertex_index(
+		primitive_topology in_topology, size_t primitive_id, size_t vertex);
+	primitive_list assemble_primitives(
+		const draw_bindings& in_bindings, const vertex_positions& in_positions,
+		size_t num_primitives, size_t offset, bool indexed, draw_statistics& out_statistics);
+	void draw_primitives(const primitive_list& in_primitives);
+	bool get_draw_rect(
+		const primitive_list& in_primitives, int2& out_rect_begin, int2& out_rect_end);
+	void prepare_depth_tiles();
+	void reset_farthest_samples();
+	void fill_tile(int tile_x, int tile_y);
+	template<typename T>
+	static void fill_resource(cg::resource<T>& in_out_resource, const T& in_value);
+	void prepare_samples();
+	// Internal resources are written before they are read
+	static constexpr cg::allocation_policy uninitialized{ true };
+	// Resources with a value per sample, in the layout of the render target.
+	// They are filled by the caller.
+	template<typename T>
+	std::shared_ptr<cg::resource<T>> create_sample_resource() const;
+	template<typename T>
+	bool is_sample_resource(const std::shared_ptr<cg::resource<T>>& in_resource) const;
+	void check_target_layout() const;
+	void resolve_draws();
+	void resolve_samples(int2 rect_begin, int2 rect_end);
+	void draw_visibility(const primitive_list& in_primitives, const bin_list& in_bins);
+	void resolve_visibility();
+	bin_list bin_primitives(const primitive_list& in_primitives);
+	void rasterize_primitives(const primitive_list& in_primitives, const bin_list& in_bins);
+
+	void process_vertices(
+		const draw_bindings& in_bindings, size_t vertex_offset, size_t num_vertexes,
+		const unsigned char* referenced, vertex_positions& out_positions);
+	void project_positions(vertex_positions& in_out_positions, size_t begin, size_t end);
+	VB fetch_vertex(
+		const draw_bindings& in_bindings, const vertex_positions& in_positions,
+		size_t vertex_id);
+	void assemble_primitive(
+		const draw_bindings& in_bindings, const vertex_positions& in_positions,
+		const size_t* vertex_ids, primitive& out_primitive,
+		primitive_list& out_clipped_primitives);
+	void clip_primitive(
+		const clip_vertex* in_vertices, unsigned clip_planes, float2 guard_band_extent,
+		primitive_list& out_primitives);
+	void merge_clipped_primitives(
+		primitive_list& in_out_primitives, std::pmr::vector<primitive_list>& in_clipped_primitives);
+	unsigned get_outcode(const float4& position, float2 extent);
+	float2 get_guard_band_extent();
+	VB project_vertex(const clip_vertex& in_vertex);
+	void setup_primitive(primitive& out_primitive);
+	void setup_planes(primitive& out_primitive);
+	void rasterize_primitive(
+		const primitive& in_primitive, int2 rect_begin, int2 rect_end,
+		draw_statistics& out_statistics);
+	void rasterize_block(
+		const primitive& in_primitive, int block_x, int block_y, const int64_t* block_edges,
+		int2 begin, int2 end, const int64_t* sample_offsets, draw_statistics& out_statistics);
+	unsigned evaluate_block(const primitive& in_primitive, const int64_t* block_edges);
+	unsigned evaluate_edge(const edge_equation& in_edge, int64_t value);
+	void shade_block(
+		const primitive& in_primitive, int x, int y, const int64_t* block_edges,
+		unsigned coverage, const unsigned* sample_coverage, const int64_t* sample_offsets,
+		draw_statistics& out_statistics);
+	void shade_fragment(
+		const primitive& in_primitive, int x, int y, const int64_t* pixel_edges,
+		unsigned samples, const int64_t* sample_offsets, const float* plane_values,
+		draw_statistics& out_statistics);
+	float interpolate_depth(const primitive& in_primitive, const int64_t* edges);
+	static RT to_target_color(const cg::color& in_color);
+
+	void evaluate_planes(const primitive& in_primitive, int x, int y, float* out_values);
+	cg::decoded_vertex_t<VB> interpolate_planes(
+		const primitive& in_primitive, const float* plane_values, int x, int y, float z);
+
+	float3 get_barycentric(
+		const primitive& in_primitive, int64_t edge0, int64_t edge1, int64_t edge2);
+
+	edge_equation setup_edge(int2 a, int2 b);
 	bool depth_test(float z, size_t x, size_t y);
+	float get_depth_tile_max(int tile_x, int tile_y);
+	bool is_tile_occluded(const primitive& in_primitive, int tile_x, int tile_y);
 };
 
-template<typename VB, typename RT>
-inline void rasterizer<VB, RT>::set_render_target(
+// Defined outside of the rasterizer, so only the draws of the visibility
+// buffer instantiate the primitives of VB
+template<typename VB, typename RT, typename VS, typename PS>
+struct rasterizer<VB, RT, VS, PS>::visibility_batch
+{
+	std::vector<visibility_draw> draws;
+	std::vector<primitive> primitives;
+};
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_render_target(
 	std::shared_ptr<resource<RT>> in_render_target,
 	std::shared_ptr<resource<float>> in_depth_buffer)
 {
+	// Lazy clears and samples belong to the previous targets
+	resolve();
+	resolve_clear();
+
 	if (in_render_target)
 		render_target = in_render_target;
 
 	if (in_depth_buffer)
+	{
+		// Content of the new depth buffer is unknown, the tiles are recreated
+		// on the next use
 		depth_buffer = in_depth_buffer;
+		depth_tiles = nullptr;
+	}
+	bind_views();
 }
 
-template<typename VB, typename RT>
-inline void rasterizer<VB, RT>::clear_render_target(const RT& in_clear_value, const float in_depth)
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::bind_views()
 {
+	auto get_view = [](const auto& in_resource) {
+		return in_resource ? in_resource->get_view()
+						   : decltype(in_resource->get_view()){};
+	};
+	render_target_view = get_view(render_target);
+	depth_buffer_view = get_view(depth_buffer);
+	primitive_ids_view = get_view(primitive_ids);
+	color_samples_view = get_view(color_samples);
+	depth_tiles_view = get_view(depth_tiles);
+	depth_tiles_farthest_view = get_view(depth_tiles_farthest);
+	depth_tiles_cleared_view = get_view(depth_tiles_cleared);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::clear_render_target(const RT& in_clear_value, const float in_depth)
+{
+	check_target_layout();
+	clear_value = in_clear_value;
+	clear_depth = in_depth;
+	const bool lazy = fast_clear && depth_buffer;
+
 	if (render_target)
 	{
-		for (size_t i = 0; i < render_target->get_number_of_elements(); i++)
+		if (sample_count > 1)
+			prepare_samples();
+
+		if (!lazy)
 		{
-			render_target->item(i) = in_clear_value;
+			fill_resource(*render_target, in_clear_value);
+			if (sample_count > 1)
+				fill_resource(*color_samples, in_clear_value);
 		}
 	}
 
 	if (depth_buffer)
 	{
-		for (size_t i = 0; i < depth_buffer->get_number_of_elements(); i++)
+		if (!lazy)
+			fill_resource(*depth_buffer, in_depth);
+
+		prepare_depth_tiles();
+		fill_resource(*depth_tiles, in_depth);
+		reset_farthest_samples();
+		fill_resource(*depth_tiles_cleared, static_cast<unsigned char>(lazy ? 1 : 0));
+	}
+
+	// Pending draws are covered by the clear
+	if (primitive_ids)
+		fill_resource(*primitive_ids, empty_primitive_id);
+	num_visibility_draws = 0;
+	visibility_begin = int2{ INT_MAX, INT_MAX };
+	visibility_end = int2{ -1, -1 };
+
+	// Samples are at the clear value with their pixels
+	unresolved_begin = int2{ INT_MAX, INT_MAX };
+	unresolved_end = int2{ -1, -1 };
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::resolve_clear()
+{
+	if (!depth_tiles)
+		return;
+
+	const int tiles_x = static_cast<int>(depth_tiles->get_stride());
+	const int num_tiles = static_cast<int>(depth_tiles->get_number_of_elements());
+
+#pragma omp parallel for
+	for (int tile_id = 0; tile_id < num_tiles; tile_id++)
+	{
+		if (depth_tiles_cleared_view(tile_id % tiles_x, tile_id / tiles_x))
+			fill_tile(tile_id % tiles_x, tile_id / tiles_x);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::resolve()
+{
+	if constexpr (can_draw<VB, RT>::value)
+	{
+		if (pending_draws)
+			resolve_draws();
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::resolve_draws()
+{
+	resolve_visibility();
+
+	if (unresolved_begin.x <= unresolved_end.x && unresolved_begin.y <= unresolved_end.y &&
+		sample_count > 1 && render_target && is_sample_resource(color_samples))
+		resolve_samples(unresolved_begin, unresolved_end);
+
+	unresolved_begin = int2{ INT_MAX, INT_MAX };
+	unresolved_end = int2{ -1, -1 };
+	pending_draws = false;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::fill_tile(int tile_x, int tile_y)
+{
+	// Rows of a tile are contiguous in every target
+	const size_t x_begin = tile_x * depth_tile_size;
+	const size_t y_begin = tile_y * depth_tile_size;
+	const size_t depth_width = depth_buffer_view.get_width() / sample_count;
+	const size_t tile_width = std::min<size_t>(depth_tile_size, depth_width - x_begin);
+	const size_t tile_height =
+		std::min<size_t>(depth_tile_size, depth_buffer_view.get_height() - y_begin);
+
+	auto fill_rows = [](const auto& view, const auto& value) {
+		for (size_t y = 0; y < view.get_height(); y++)
 		{
-			depth_buffer->item(i) = in_depth;
+			auto row = view.row(y);
+			std::fill(row.begin(), row.end(), value);
 		}
+	};
+
+	fill_rows(
+		depth_buffer_view.subview(
+			x_begin * sample_count, y_begin, tile_width * sample_count, tile_height),
+		clear_depth);
+
+	if (render_target && x_begin < render_target_view.get_width() &&
+		y_begin < render_target_view.get_height())
+	{
+		const size_t target_width = std::min(tile_width, render_target_view.get_width() - x_begin);
+		const size_t target_height =
+			std::min(tile_height, render_target_view.get_height() - y_begin);
+		fill_rows(
+			render_target_view.subview(x_begin, y_begin, target_width, target_height),
+			clear_value);
+		if (sample_count > 1)
+			fill_rows(
+				color_samples_view.subview(
+					x_begin * sample_count, y_begin, target_width * sample_count, target_height),
+				clear_value);
 	}
+
+	depth_tiles_cleared_view(tile_x, tile_y) = 0;
 }
 
-template<typename VB, typename RT>
-inline void rasterizer<VB, RT>::set_vertex_buffer(std::shared_ptr<resource<VB>> in_vertex_buffer)
+template<typename VB, typename RT, typename VS, typename PS>
+template<typename T>
+inline void rasterizer<VB, RT, VS, PS>::fill_resource(
+	cg::resource<T>& in_out_resource, const T& in_value)
+{
+	// Chunks are filled in parallel, std::fill of a contiguous range is
+	// vectorized by the compiler. Padding of the tiles is filled too.
+	constexpr size_t chunk_size = 64 * 1024;
+	const cg::span<T> storage = in_out_resource.get_span();
+	const size_t num_elements = storage.size;
+	if (num_elements == 0)
+		return;
+
+	T* data = storage.data;
+	const int num_chunks = static_cast<int>((num_elements + chunk_size - 1) / chunk_size);
+
+#pragma omp parallel for
+	for (int chunk = 0; chunk < num_chunks; chunk++)
+	{
+		size_t begin = static_cast<size_t>(chunk) * chunk_size;
+		size_t end = std::min(begin + chunk_size, num_elements);
+		std::fill(data + begin, data + end, in_value);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_vertex_buffer(std::shared_ptr<resource<VB>> in_vertex_buffer)
 {
 	vertex_buffer = in_vertex_buffer;
 }
 
-template<typename VB, typename RT>
-inline void rasterizer<VB, RT>::set_viewport(size_t in_width, size_t in_height)
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_index_buffer(
+	std::shared_ptr<resource<uint32_t>> in_index_buffer)
+{
+	index_buffer = in_index_buffer;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_viewport(size_t in_width, size_t in_height)
 {
 	width = in_width;
 	height = in_height;
 }
 
-template<typename VB, typename RT>
-inline void rasterizer<VB, RT>::draw(size_t num_vertexes, size_t vertex_offset)
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_arena(std::shared_ptr<cg::frame_arena> in_arena)
 {
-	size_t vertex_id = vertex_offset;
+	if (!in_arena)
+		THROW_ERROR("Arena should not be null");
+	arena = in_arena;
+}
 
-	while (vertex_id < vertex_offset + num_vertexes)
-	{
-		// Input assembly
-		std::vector<VB> vertices(3);
-		vertices[0] = vertex_buffer->item(vertex_id++);
-		vertices[1] = vertex_buffer->item(vertex_id++);
-		vertices[2] = vertex_buffer->item(vertex_id++);
+template<typename VB, typename RT, typename VS, typename PS>
+inline std::shared_ptr<cg::frame_arena> rasterizer<VB, RT, VS, PS>::get_arena() const
+{
+	return arena;
+}
 
-		for (auto& vertex : vertices)
-		{
-			float4 coords { vertex.x, vertex.y, vertex.z, 1.f};
-			auto processed_vertex = vertex_shader(coords, vertex);
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::draw(size_t num_vertexes, size_t vertex_offset)
+{
+	submit_draw(num_vertexes, vertex_offset, false);
+}
 
-			// Back to cartesian
-			vertex.x = processed_vertex.first.x / processed_vertex.first.w;
-			vertex.y = processed_vertex.first.y / processed_vertex.first.w;
-			vertex.z = processed_vertex.first.z / processed_vertex.first.w;
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::draw_indexed(size_t num_indexes, size_t index_offset)
+{
+	submit_draw(num_indexes, index_offset, true);
+}
 
-			vertex.x = (vertex.x + 1.f) * width / 2.f;
-			vertex.y = (-vertex.y + 1.f) * height / 2.f;
-		}
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::submit_draw(size_t count, size_t offset, bool indexed)
+{
+	statistics = draw_statistics{};
+	if (is_occluded(predicate))
+	{
+		statistics.skipped_draws = 1;
+		return;
+	}
 
-		float2 bounding_box_begin {
-			std::clamp(
-				std::min(vertices[0].x, std::min(vertices[1].x, vertices[2].x)), 
-				0.f, static_cast<float>(width) - 1.f), 
-			std::clamp(
-				std::min(vertices[0].y, std::min(vertices[1].y, vertices[2].y)), 
-				0.f, static_cast<float>(height) - 1.f)
-		};
-		float2 bounding_box_end{
-			std::clamp(
-				std::max(vertices[0].x, std::max(vertices[1].x, vertices[2].x)),
-				0.f, static_cast<float>(width) - 1.f),
-			std::clamp(
-				std::max(vertices[0].y, std::max(vertices[1].y, vertices[2].y)),
-				0.f, static_cast<float>(height) - 1.f)
-		};
+	cg::frame_arena::scope scratch(*arena);
+	const draw_bindings bindings = get_bindings();
+	const vertex_range range = get_vertex_range(bindings, count, offset, indexed);
+	draw_primitives(setup_draw(bindings, count, offset, indexed, range, statistics));
+	if (active_query != no_query)
+		query_results[active_query] += statistics.passed_samples;
+}
 
-		float edge = edge_function(
-			float2{ vertices[0].x, vertices[0].y },
-			float2{ vertices[1].x, vertices[1].y },
-			float2{ vertices[2].x, vertices[2].y });
+template<typename VB, typename RT, typename VS, typename PS>
+inline bool rasterizer<VB, RT, VS, PS>::is_occluded(size_t in_query) const
+{
+	return in_query < query_results.size() && query_results[in_query] == 0;
+}
 
-		for (int x = static_cast<int>(bounding_box_begin.x); 
-			x <= static_cast<int>(bounding_box_end.x); x++)
-		{
-			for (int y = static_cast<int>(bounding_box_begin.y);
-				 y <= static_cast<int>(bounding_box_end.y); y++)
-			{
-				float2 screen_point = float2{ static_cast<float>(x), static_cast<float>(y) };
-
-				// bary for vertices[2]
-				float edge0 = edge_function(
-					float2{ vertices[0].x, vertices[0].y },
-					float2{ vertices[1].x, vertices[1].y }, screen_point);
-				// bary for vertices[0]
-				float edge1 = edge_function(
-					float2{ vertices[1].x, vertices[1].y },
-					float2{ vertices[2].x, vertices[2].y }, screen_point);
-				// bary for vertices[1]
-				float edge2 = edge_function(
-					float2{ vertices[2].x, vertices[2].y },
-					float2{ vertices[0].x, vertices[0].y }, screen_point);
-
-				if (edge0 >= 0.f && edge1 >= 0.f && edge2 >= 0.f)
-				{
-					float u, v, w;
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::begin_query(size_t in_query)
+{
+	if (in_query == no_query)
+		THROW_ERROR("Query id is not valid");
+	if (in_query >= query_results.size())
+		query_results.resize(in_query + 1, 0);
+	query_results[in_query] = 0;
+	active_query = in_query;
+}
 
-					if (smooth_shading)
-					{
-						u = edge1 / edge;
-						v = edge2 / edge;
-						w = edge0 / edge;
-					}
-					else
-					{
-						u = 0.333f;
-						v = 0.333f;
-						w = 0.333f;
-					}
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::end_query()
+{
+	active_query = no_query;
+}
 
-					float z =
-						u * vertices[0].z + v * vertices[1].z + w * vertices[2].z;
-					if (depth_test(z, x, y))
-					{
-						// interpolate via barycentric coordinates
-						vertex interpolated_vertex = VB::interpolate_bary(
-							vertices[0], vertices[1], vertices[2], u, v, w);
-						auto pixel_shader_result =
-							pixel_shader(interpolated_vertex, z);
-						render_target->item(x, y) =
-							cg::unsigned_color::from_color(pixel_shader_result);
-
-						if (depth_buffer)
-							depth_buffer->item(x, y) = z;
-					}
-				}
-			}
-		}
-	}
+template<typename VB, typename RT, typename VS, typename PS>
+inline size_t rasterizer<VB, RT, VS, PS>::get_query_result(size_t in_query) const
+{
+	if (in_query >= query_results.size())
+		THROW_ERROR("Query was never begun");
+	return query_results[in_query];
 }
 
-template<typename VB, typename RT>
-inline float rasterizer<VB, RT>::edge_function(float2 a, float2 b, float2 c)
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::set_predicate(size_t in_query)
 {
-	return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
+	predicate = in_query;
 }
 
-template<typename VB, typename RT>
-inline bool rasterizer<VB, RT>::depth_test(float z, size_t x, size_t y)
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::execute(const command_list<VB, VS, PS>& in_command_list)
 {
-	if (!depth_buffer)
-		return true;
+	statistics = draw_statistics{};
+	const auto& commands = in_command_list.get_commands();
+	const int num_commands = static_cast<int>(commands.size());
+	cg::frame_arena::scope scratch(*arena);
+	std::pmr::memory_resource* scratch_resource = arena.get();
 
-	return depth_buffer->item(x, y) > z;
-}
+	// Queries which the list counts into start from zero, so the draws
+	// predicated on them wait for the result
+	std::pmr::vector<unsigned char> counted(query_results.size(), 0, scratch_resource);
+	for (const auto& command : commands)
+	{
+		if (command.query == no_query)
+			continue;
+		if (command.query >= query_results.size())
+		{
+			query_results.resize(command.query + 1, 0);
+			counted.resize(command.query + 1, 0);
+		}
+		query_results[command.query] = 0;
+		counted[command.query] = 1;
+	}
+
+	std::pmr::vector<unsigned char> deferred(num_commands, 0, scratch_resource);
+	std::pmr::vector<unsigned char> skipped(num_commands, 0, scratch_resource);
+	for (int i = 0; i < num_commands; i++)
+	{
+		size_t predicate_query = commands[i].predicate;
+		if (predicate_query < counted.size() && counted[predicate_query])
+			deferred[i] = 1;
+		else
+			skipped[i] = is_occluded(predicate_query);
+	}
 
+	// Draws are set up with their own bindings, in parallel if the vertex
+	// stage is, whichever backend rasterizes them. Ranges are checked before
+	// the parallel loop, and other errors are rethrown after it, as an
+	// exception can't leave an OpenMP region.
+	std::pmr::vector<draw_bindings> bindings(num_commands, scratch_resource);
+	std::pmr::vector<vertex_range> ranges(num_commands, scratch_resource);
+	for (int i = 0; i < num_commands; i++)
+	{
+		if (deferred[i] || skipped[i])
+			continue;
+
+		const auto& command = commands[i];
+		bindings[i] = get_bindings(
+			command.vertex_shader, command.vertex_buffer.get(), command.index_buffer.get(),
+			command.topology, false);
+		ranges[i] = get_vertex_range(bindings[i], command.count, command.offset, command.indexed);
+	}
+
+	std::pmr::vector<primitive_list> primitives(num_commands, scratch_resource);
+	std::pmr::vector<draw_statistics> setup_statistics(num_commands, scratch_resource);
+	std::pmr::vector<float> nearest_depths(num_commands, FLT_MAX, scratch_resource);
+	std::pmr::vector<std::exception_ptr> errors(num_commands, scratch_resource);
+
+#pragma omp parallel for schedule(dynamic) if (parallel_vertex_processing && num_commands > 1)
+	for (int i = 0; i < num_commands; i++)
+	{
+		if (deferred[i] || skipped[i])
+			continue;
+
+		const auto& command = commands[i];
+		try
+		{
+			primitives[i] = setup_draw(
+				bindings[i], command.count, command.offset, command.indexed, ranges[i],
+				setup_statistics[i]);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+			continue;
+		}
+		for (const primitive& primitive : primitives[i])
+		{
+			if (primitive.visible)
+				nearest_depths[i] = std::min(nearest_depths[i], primitive.depth_min);
+		}
+	}
+	for (const std::exception_ptr& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	// A predicated draw is sorted after the farthest draw of its query and
+	// isn't reordered if any of them is transparent
+	std::pmr::vector<float> query_depths(counted.size(), -FLT_MAX, scratch_resource);
+	std::pmr::vector<unsigned char> query_opaque(counted.size(), 1, scratch_resource);
+	for (int i = 0; i < num_commands; i++)
+	{
+		size_t query = commands[i].query;
+		if (query == no_query)
+			continue;
+		query_depths[query] = std::max(query_depths[query], nearest_depths[i]);
+		query_opaque[query] &= commands[i].opaque ? 1 : 0;
+	}
+
+	std::pmr::vector<unsigned char> opaque(num_commands, scratch_resource);
+	for (int i = 0; i < num_commands; i++)
+	{
+		opaque[i] = commands[i].opaque;
+		if (deferred[i])
+		{
+			nearest_depths[i] = query_depths[commands[i].predicate];
+			opaque[i] &= query_opaque[commands[i].predicate];
+		}
+	}
+
+	std::pmr::vector<int> order(scratch_resource);
+	order.reserve(num_commands);
+	for (int i = 0; i < num_commands; i++)
+	{
+		statistics += setup_statistics[i];
+		if (opaque[i])
+			order.push_back(i);
+	}
+	// A predicated draw has the depth of the farthest draw of its query, so
+	// at equal depths the draws which count into queries go first, whatever
+	// order they were recorded in. Other ties keep the order of the list,
+	// std::sort doesn't take a buffer.
+	// Bound state isn't a key: the primitives already hold their vertices,
+	// so switching draws only copies the shaders and the write flags, and
+	// shaders can't be compared to group the draws which share one.
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		if (nearest_depths[a] != nearest_depths[b])
+			return nearest_depths[a] < nearest_depths[b];
+		if (deferred[a] != deferred[b])
+			return deferred[a] < deferred[b];
+		return a < b;
+	});
+	for (int i = 0; i < num_commands; i++)
+	{
+		if (!opaque[i])
+			order.push_back(i);
+	}
+
+	VS bound_vertex_shader = vertex_shader;
+	PS bound_pixel_shader = pixel_shader;
+	auto bound_vertex_buffer = vertex_buffer;
+	auto bound_index_buffer = index_buffer;
+	primitive_topology bound_topology = topology;
+	bool bound_color_write = color_write;
+	bool bound_depth_write = depth_write;
+
+	for (int i : order)
+	{
+		const auto& command = commands[i];
+		if (skipped[i] || (deferred[i] && query_results[command.predicate] == 0))
+		{
+			statistics.skipped_draws++;
+			continue;
+		}
+
+		vertex_shader = command.vertex_shader;
+		pixel_shader = command.pixel_shader;
+		vertex_buffer = command.vertex_buffer;
+		index_buffer = command.index_buffer;
+		topology = command.topology;
+		color_write = command.color_write;
+		depth_write = command.depth_write;
+
+		if (deferred[i])
+		{
+			draw_statistics deferred_statistics;
+			const draw_bindings deferred_bindings = get_bindings();
+			primitives[i] = setup_draw(
+				deferred_bindings, command.count, command.offset, command.indexed,
+				get_vertex_range(deferred_bindings, command.count, command.offset, command.indexed),
+				deferred_statistics);
+			statistics += deferred_statistics;
+		}
+
+		size_t passed_samples = statistics.passed_samples;
+		draw_primitives(primitives[i]);
+		if (command.query != no_query)
+			query_results[command.query] += statistics.passed_samples - passed_samples;
+	}
+
+	vertex_shader = bound_vertex_shader;
+	pixel_shader = bound_pixel_shader;
+	vertex_buffer = bound_vertex_buffer;
+	index_buffer = bound_index_buffer;
+	topology = bound_topology;
+	color_write = bound_color_write;
+	depth_write = bound_depth_write;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::draw_bindings
+	rasterizer<VB, RT, VS, PS>::get_bindings() const
+{
+	return get_bindings(
+		vertex_shader, vertex_buffer.get(), index_buffer.get(), topology,
+		parallel_vertex_processing);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::draw_bindings
+	rasterizer<VB, RT, VS, PS>::get_bindings(
+		const VS& in_vertex_shader, resource<VB>* in_vertex_buffer,
+		resource<uint32_t>* in_index_buffer, primitive_topology in_topology, bool in_parallel)
+{
+	// Missing buffers are empty, so the draws which read them fail the
+	// range check
+	return draw_bindings{ &in_vertex_shader,
+						  in_vertex_buffer ? in_vertex_buffer->get_span() : span<VB>{},
+						  in_index_buffer ? in_index_buffer->get_span() : span<uint32_t>{},
+						  in_topology, in_parallel };
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::vertex_range
+	rasterizer<VB, RT, VS, PS>::get_vertex_range(
+		const draw_bindings& in_bindings, size_t count, size_t offset, bool indexed)
+{
+	if (!indexed)
+	{
+		if (offset + count > in_bindings.vertices.size)
+			THROW_ERROR("Draw call should be inside of the vertex buffer");
+		return vertex_range{ offset, count };
+	}
+
+	if (offset + count > in_bindings.indices.size)
+		THROW_ERROR("Draw call should be inside of the index buffer");
+	if (count == 0)
+		return vertex_range{};
+
+	const uint32_t* indices = in_bindings.indices.data;
+	uint32_t min_index = UINT32_MAX;
+	uint32_t max_index = 0;
+	for (size_t i = offset; i < offset + count; i++)
+	{
+		min_index = std::min(min_index, indices[i]);
+		max_index = std::max(max_index, indices[i]);
+	}
+	if (max_index >= in_bindings.vertices.size)
+		THROW_ERROR("Indices should be inside of the vertex buffer");
+	return vertex_range{ min_index, static_cast<size_t>(max_index - min_index) + 1 };
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::primitive_list rasterizer<VB, RT, VS, PS>::setup_draw(
+	const draw_bindings& in_bindings, size_t count, size_t offset, bool indexed,
+	const vertex_range& in_range, draw_statistics& out_statistics)
+{
+	const size_t num_primitives = get_num_primitives(in_bindings.topology, count);
+	vertex_positions positions(arena.get());
+	if (!indexed)
+	{
+		process_vertices(in_bindings, in_range.first, in_range.count, nullptr, positions);
+		return assemble_primitives(
+			in_bindings, positions, num_primitives, offset, false, out_statistics);
+	}
+
+	if (in_range.count == 0)
+		return primitive_list(arena.get());
+
+	// Pre-transform pass over the referenced vertices
+	const uint32_t* indices = in_bindings.indices.data;
+	std::pmr::vector<unsigned char> referenced(in_range.count, 0, arena.get());
+	for (size_t i = offset; i < offset + count; i++)
+	{
+		referenced[indices[i] - in_range.first] = 1;
+	}
+
+	process_vertices(in_bindings, in_range.first, in_range.count, referenced.data(), positions);
+	return assemble_primitives(in_bindings, positions, num_primitives, offset, true, out_statistics);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline size_t rasterizer<VB, RT, VS, PS>::get_num_primitives(
+	primitive_topology in_topology, size_t count)
+{
+	if (in_topology == primitive_topology::triangle_list)
+		return count / 3;
+	return count >= 3 ? count - 2 : 0;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline size_t rasterizer<VB, RT, VS, PS>::get_vertex_index(
+	primitive_topology in_topology, size_t primitive_id, size_t vertex)
+{
+	// Position of the vertex in the vertex or index range of the draw call
+	switch (in_topology)
+	{
+		case primitive_topology::triangle_strip:
+			if (primitive_id % 2 == 1 && vertex < 2)
+				return primitive_id + 1 - vertex;
+			return primitive_id + vertex;
+		case primitive_topology::triangle_fan:
+			return vertex == 0 ? 0 : primitive_id + vertex;
+		default:
+			return 3 * primitive_id + vertex;
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::primitive_list
+	rasterizer<VB, RT, VS, PS>::assemble_primitives(
+		const draw_bindings& in_bindings, const vertex_positions& in_positions,
+		size_t num_primitives, size_t offset, bool indexed, draw_statistics& out_statistics)
+{
+	// Setup: primitives are independent
+	const int num_triangles = static_cast<int>(num_primitives);
+	primitive_list primitives(num_triangles, arena.get());
+	std::pmr::vector<primitive_list> clipped_primitives(num_triangles, arena.get());
+
+	size_t culled_triangles = 0;
+	size_t clipped_triangles = 0;
+	size_t clipped_parts = 0;
+
+#pragma omp parallel for if (in_bindings.parallel) reduction(+ : culled_triangles, clipped_triangles, clipped_parts)
+	for (int primitive_id = 0; primitive_id < num_triangles; primitive_id++)
+	{
+		// Input assembly
+		size_t vertex_ids[3];
+		for (size_t i = 0; i < 3; i++)
+		{
+			size_t id = offset + get_vertex_index(in_bindings.topology, primitive_id, i);
+			vertex_ids[i] = indexed ? in_bindings.indices[id] : id;
+		}
+
+		assemble_primitive(
+			in_bindings, in_positions, vertex_ids, primitives[primitive_id],
+			clipped_primitives[primitive_id]);
+
+		if (!clipped_primitives[primitive_id].empty())
+		{
+			clipped_triangles++;
+			clipped_parts += clipped_primitives[primitive_id].size();
+		}
+		else if (!primitives[primitive_id].visible)
+		{
+			culled_triangles++;
+		}
+	}
+
+	out_statistics.submitted_triangles = num_primitives;
+	out_statistics.culled_triangles = culled_triangles;
+	out_statistics.clipped_triangles = clipped_triangles;
+	out_statistics.rasterized_triangles =
+		num_primitives - culled_triangles - clipped_triangles + clipped_parts;
+
+	merge_clipped_primitives(primitives, clipped_primitives);
+	for (size_t i = 0; i < primitives.size(); i++)
+		primitives[i].id = static_cast<uint32_t>(i);
+	return primitives;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::draw_primitives(const primitive_list& in_primitives)
+{
+	if (sample_count != 1 && sample_count != 2 && sample_count != 4 && sample_count != 8)
+		THROW_ERROR("Sample count should be 1, 2, 4 or 8");
+	check_target_layout();
+	if (depth_buffer)
+	{
+		if (depth_buffer->get_stride() < width * sample_count)
+			THROW_ERROR("Depth buffer should have a depth per sample");
+		prepare_depth_tiles();
+	}
+	if (sample_count > 1)
+		prepare_samples();
+
+	pass = raster_pass::color;
+
+	bin_list bins(arena.get());
+	if (tiled_rasterization)
+		bins = bin_primitives(in_primitives);
+
+	// The visibility buffer and the pre-pass write both color and depth
+	const bool full_write = color_write && depth_write;
+	// Ids hold up to 2^22 primitives of a draw, larger draws are shaded forward
+	const bool visibility = visibility_buffer && depth_buffer && full_write &&
+							in_primitives.size() <= (size_t(1) << visibility_primitive_bits);
+	// Colors of the pending visibility draws are behind the other draws
+	if (!visibility && color_write)
+		resolve_visibility();
+
+	if (visibility)
+	{
+		draw_visibility(in_primitives, bins);
+	}
+	else if (depth_prepass && depth_buffer && full_write)
+	{
+		pass = raster_pass::depth_only;
+		rasterize_primitives(in_primitives, bins);
+		pass = raster_pass::depth_equal;
+		rasterize_primitives(in_primitives, bins);
+		pass = raster_pass::color;
+	}
+	else
+	{
+		pass = color_write ? raster_pass::color : raster_pass::depth_only;
+		rasterize_primitives(in_primitives, bins);
+		pass = raster_pass::color;
+	}
+
+	// Samples are averaged into the render target by resolve
+	pending_draws = true;
+	int2 rect_begin, rect_end;
+	if (sample_count > 1 && color_write && get_draw_rect(in_primitives, rect_begin, rect_end))
+	{
+		unresolved_begin = min(unresolved_begin, rect_begin);
+		unresolved_end = max(unresolved_end, rect_end);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline bool rasterizer<VB, RT, VS, PS>::get_draw_rect(
+	const primitive_list& in_primitives, int2& out_rect_begin, int2& out_rect_end)
+{
+	// Union of the bounding boxes, false if nothing is visible
+	out_rect_begin = int2{ static_cast<int>(width), static_cast<int>(height) };
+	out_rect_end = int2{ -1, -1 };
+	for (const primitive& primitive : in_primitives)
+	{
+		if (!primitive.visible)
+			continue;
+		out_rect_begin = min(out_rect_begin, primitive.bounding_box_begin);
+		out_rect_end = max(out_rect_end, primitive.bounding_box_end);
+	}
+	return out_rect_begin.x <= out_rect_end.x && out_rect_begin.y <= out_rect_end.y;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::prepare_depth_tiles()
+{
+	// Tiles cover 8x8 pixels with all of their samples
+	size_t depth_width = depth_buffer->get_stride() / sample_count;
+	size_t depth_height = depth_buffer->get_number_of_elements() / depth_buffer->get_stride();
+	size_t tiles_x = (depth_width + depth_tile_size - 1) / depth_tile_size;
+	size_t tiles_y = (depth_height + depth_tile_size - 1) / depth_tile_size;
+	if (depth_tiles && depth_tiles->get_stride() == tiles_x &&
+		depth_tiles->get_number_of_elements() == tiles_x * tiles_y)
+		return;
+
+	// Farthest depths are computed before they are read
+	depth_tiles = std::make_shared<cg::resource<float>>(tiles_x, tiles_y, uninitialized);
+	depth_tiles_farthest =
+		std::make_shared<cg::resource<uint32_t>>(tiles_x, tiles_y, uninitialized);
+	depth_tiles_cleared =
+		std::make_shared<cg::resource<unsigned char>>(tiles_x, tiles_y, uninitialized);
+	fill_resource(*depth_tiles_farthest, static_cast<uint32_t>(0));
+	fill_resource(*depth_tiles_cleared, static_cast<unsigned char>(0));
+	bind_views();
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::reset_farthest_samples()
+{
+	// Every sample of a cleared tile is at the farthest depth, tiles at the
+	// right and bottom borders may be partial
+	const size_t depth_width = depth_buffer_view.get_width() / sample_count;
+	const size_t depth_height = depth_buffer_view.get_height();
+	for (size_t tile_y = 0; tile_y < depth_tiles_farthest_view.get_height(); tile_y++)
+	{
+		const size_t tile_height =
+			std::min<size_t>(depth_tile_size, depth_height - tile_y * depth_tile_size);
+		for (size_t tile_x = 0; tile_x < depth_tiles_farthest_view.get_width(); tile_x++)
+		{
+			const size_t tile_width =
+				std::min<size_t>(depth_tile_size, depth_width - tile_x * depth_tile_size);
+			depth_tiles_farthest_view(tile_x, tile_y) =
+				static_cast<uint32_t>(tile_width * tile_height * sample_count);
+		}
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::prepare_samples()
+{
+	if (is_sample_resource(color_samples))
+		return;
+
+	// Samples start with the color of their pixel
+	size_t target_width = render_target->get_stride();
+	size_t target_height = render_target->get_number_of_elements() / target_width;
+	color_samples = create_sample_resource<RT>();
+	bind_views();
+	for (size_t y = 0; y < target_height; y++)
+	{
+		for (size_t x = 0; x < target_width; x++)
+		{
+			for (size_t s = 0; s < sample_count; s++)
+				color_samples_view(x * sample_count + s, y) = render_target_view(x, y);
+		}
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+template<typename T>
+inline std::shared_ptr<cg::resource<T>> rasterizer<VB, RT, VS, PS>::create_sample_resource() const
+{
+	// Tiles of a tiled render target keep their pixels with all of the samples
+	size_t target_width = render_target->get_stride();
+	size_t target_height = render_target->get_number_of_elements() / target_width;
+	if (!render_target->is_tiled())
+		return std::make_shared<cg::resource<T>>(
+			target_width * sample_count, target_height, uninitialized);
+
+	return std::make_shared<cg::resource<T>>(
+		target_width * sample_count, target_height,
+		render_target->get_tile_width() * sample_count, render_target->get_tile_height(),
+		uninitialized);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+template<typename T>
+inline bool rasterizer<VB, RT, VS, PS>::is_sample_resource(
+	const std::shared_ptr<cg::resource<T>>& in_resource) const
+{
+	return in_resource && in_resource->get_stride() == render_target->get_stride() * sample_count &&
+		   in_resource->get_number_of_elements() ==
+			   render_target->get_number_of_elements() * sample_count &&
+		   in_resource->is_tiled() == render_target->is_tiled() &&
+		   (!render_target->is_tiled() ||
+			(in_resource->get_tile_width() == render_target->get_tile_width() * sample_count &&
+			 in_resource->get_tile_height() == render_target->get_tile_height()));
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::check_target_layout() const
+{
+	// Rows of a tile of the rasterizer are filled as contiguous ranges
+	if (render_target && render_target->is_tiled() &&
+		(render_target->get_tile_width() % target_tile_size != 0 ||
+		 render_target->get_tile_height() % target_tile_size != 0))
+		THROW_ERROR("Render target tiles should be multiples of the rasterizer tiles");
+	if (depth_buffer && depth_buffer->is_tiled() &&
+		(depth_buffer->get_tile_width() % (target_tile_size * sample_count) != 0 ||
+		 depth_buffer->get_tile_height() % target_tile_size != 0))
+		THROW_ERROR("Depth buffer tiles should be multiples of the rasterizer tiles with their samples");
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::resolve_samples(int2 rect_begin, int2 rect_end)
+{
+	// Box filter, 8-bit colors are rounded to the nearest
+	const unsigned samples = sample_count;
+	using channel = decltype(RT::r);
+	using channel_sum = std::conditional_t<std::is_floating_point_v<channel>, float, unsigned>;
+	const channel_sum rounding = std::is_floating_point_v<channel> ? 0 : samples / 2;
+
+#pragma omp parallel for
+	for (int y = rect_begin.y; y <= rect_end.y; y++)
+	{
+		for (int x = rect_begin.x; x <= rect_end.x; x++)
+		{
+			// The pixel is still at the clear value
+			if (depth_buffer &&
+				depth_tiles_cleared_view(x / depth_tile_size, y / depth_tile_size))
+				continue;
+
+			channel_sum r = 0, g = 0, b = 0;
+			for (unsigned s = 0; s < samples; s++)
+			{
+				const RT& sample = color_samples_view(x * samples + s, y);
+				r += sample.r;
+				g += sample.g;
+				b += sample.b;
+			}
+
+			RT& pixel = render_target_view(x, y);
+			pixel.r = static_cast<channel>((r + rounding) / samples);
+			pixel.g = static_cast<channel>((g + rounding) / samples);
+			pixel.b = static_cast<channel>((b + rounding) / samples);
+		}
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::draw_visibility(
+	const primitive_list& in_primitives, const bin_list& in_bins)
+{
+	int2 rect_begin, rect_end;
+	if (!get_draw_rect(in_primitives, rect_begin, rect_end))
+		return;
+
+	if (!is_sample_resource(primitive_ids))
+	{
+		resolve_visibility();
+		primitive_ids = create_sample_resource<uint32_t>();
+		fill_resource(*primitive_ids, empty_primitive_id);
+		bind_views();
+		visibility_begin = int2{ INT_MAX, INT_MAX };
+		visibility_end = int2{ -1, -1 };
+	}
+	if (num_visibility_draws == max_visibility_draws)
+		resolve_visibility();
+
+	if (!pending_visibility)
+		pending_visibility = std::make_shared<visibility_batch>();
+	std::vector<visibility_draw>& draws = pending_visibility->draws;
+	std::vector<primitive>& primitives = pending_visibility->primitives;
+	if (num_visibility_draws == 0)
+	{
+		draws.clear();
+		primitives.clear();
+	}
+
+	// Ids of the resolved draws are cleared by the first pending one
+	if (num_visibility_draws == 0 && visibility_begin.x <= visibility_end.x &&
+		visibility_begin.y <= visibility_end.y)
+	{
+		primitive_ids_view
+			.subview(
+				visibility_begin.x * sample_count, visibility_begin.y,
+				(visibility_end.x - visibility_begin.x + 1) * sample_count,
+				visibility_end.y - visibility_begin.y + 1)
+			.for_each([](size_t, size_t, uint32_t& id) { id = empty_primitive_id; });
+		visibility_begin = int2{ INT_MAX, INT_MAX };
+		visibility_end = int2{ -1, -1 };
+	}
+	visibility_begin = min(visibility_begin, rect_begin);
+	visibility_end = max(visibility_end, rect_end);
+
+	visibility_draw_id = static_cast<uint32_t>(num_visibility_draws++)
+						 << visibility_primitive_bits;
+	draws.push_back(visibility_draw{ primitives.size(), pixel_shader });
+	primitives.insert(primitives.end(), in_primitives.begin(), in_primitives.end());
+
+	pass = raster_pass::visibility;
+	rasterize_primitives(in_primitives, in_bins);
+	pass = raster_pass::color;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::resolve_visibility()
+{
+	if (num_visibility_draws == 0)
+		return;
+	// Ids of another sample count are lost with their resource
+	if (!is_sample_resource(primitive_ids))
+	{
+		num_visibility_draws = 0;
+		return;
+	}
+	const std::vector<visibility_draw>& draws = pending_visibility->draws;
+	const std::vector<primitive>& primitives = pending_visibility->primitives;
+
+	// Attributes are reconstructed from the planes of the primitive, so the
+	// result is the same as of the shading during rasterization. Samples of
+	// the same primitive share the color of their pixel.
+	size_t shaded_fragments = 0;
+	const unsigned samples = sample_count;
+	const uint32_t primitive_mask = (uint32_t(1) << visibility_primitive_bits) - 1;
+
+#pragma omp parallel for reduction(+ : shaded_fragments)
+	for (int y = visibility_begin.y; y <= visibility_end.y; y++)
+	{
+		for (int x = visibility_begin.x; x <= visibility_end.x; x++)
+		{
+			uint32_t shaded_ids[max_samples];
+			RT shaded_colors[max_samples];
+			unsigned num_shaded = 0;
+
+			for (unsigned s = 0; s < samples; s++)
+			{
+				uint32_t primitive_id = primitive_ids_view(x * samples + s, y);
+				if (primitive_id == empty_primitive_id)
+					continue;
+
+				unsigned shaded = 0;
+				while (shaded < num_shaded && shaded_ids[shaded] != primitive_id)
+					shaded++;
+
+				if (shaded == num_shaded)
+				{
+					// Planes are stepped from the block origin as in shade_block
+					const visibility_draw& draw = draws[primitive_id >> visibility_primitive_bits];
+					const primitive& primitive =
+						primitives[draw.first_primitive + (primitive_id & primitive_mask)];
+					float plane_values[layout::num_planes];
+					evaluate_planes(primitive, x - x % block_size, y - y % block_size, plane_values);
+					for (int i = 0; i < y % block_size; i++)
+					{
+						for (int k = 0; k < layout::num_planes; k++)
+							plane_values[k] += primitive.planes[k].step_y;
+					}
+					for (int j = 0; j < x % block_size; j++)
+					{
+						for (int k = 0; k < layout::num_planes; k++)
+							plane_values[k] += primitive.planes[k].step_x;
+					}
+
+					int64_t edges[3];
+					for (size_t i = 0; i < 3; i++)
+					{
+						const edge_equation& edge = primitive.edges[i];
+						edges[i] = edge.c + static_cast<int64_t>(x) * edge.step_x +
+								   static_cast<int64_t>(y) * edge.step_y;
+					}
+
+					float z = interpolate_depth(primitive, edges);
+					auto interpolated_vertex = interpolate_planes(primitive, plane_values, x, y, z);
+					auto pixel_shader_result = draw.pixel_shader(interpolated_vertex, z);
+					shaded_ids[num_shaded] = primitive_id;
+					shaded_colors[num_shaded] = to_target_color(pixel_shader_result);
+					num_shaded++;
+					shaded_fragments++;
+				}
+
+				if (samples == 1)
+					render_target_view(x, y) = shaded_colors[shaded];
+				else
+					color_samples_view(x * samples + s, y) = shaded_colors[shaded];
+			}
+		}
+	}
+
+	statistics.shaded_fragments += shaded_fragments;
+	num_visibility_draws = 0;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::bin_list
+	rasterizer<VB, RT, VS, PS>::bin_primitives(const primitive_list& in_primitives)
+{
+	// Binning: keeps submission order inside of every tile
+	if (tile_size == 0)
+		THROW_ERROR("Tile size should be positive");
+	if (depth_buffer && tile_size % depth_tile_size != 0)
+		THROW_ERROR("Tile size should be a multiple of the depth tile size");
+
+	const int tile = static_cast<int>(tile_size);
+	const int tiles_x = (static_cast<int>(width) + tile - 1) / tile;
+	const int tiles_y = (static_cast<int>(height) + tile - 1) / tile;
+	bin_list bins(tiles_x * tiles_y, arena.get());
+
+	for (int primitive_id = 0; primitive_id < static_cast<int>(in_primitives.size());
+		 primitive_id++)
+	{
+		const primitive& primitive = in_primitives[primitive_id];
+		if (!primitive.visible)
+			continue;
+
+		for (int tile_y = primitive.bounding_box_begin.y / tile;
+			 tile_y <= primitive.bounding_box_end.y / tile; tile_y++)
+		{
+			for (int tile_x = primitive.bounding_box_begin.x / tile;
+				 tile_x <= primitive.bounding_box_end.x / tile; tile_x++)
+			{
+				bins[tile_y * tiles_x + tile_x].push_back(primitive_id);
+			}
+		}
+	}
+
+	return bins;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::rasterize_primitives(
+	const primitive_list& in_primitives, const bin_list& in_bins)
+{
+	if (!tiled_rasterization)
+	{
+		int2 viewport_begin{ 0, 0 };
+		int2 viewport_end{ static_cast<int>(width) - 1, static_cast<int>(height) - 1 };
+
+		for (const primitive& primitive : in_primitives)
+		{
+			if (primitive.visible)
+				rasterize_primitive(primitive, viewport_begin, viewport_end, statistics);
+		}
+		return;
+	}
+
+	const int tile = static_cast<int>(tile_size);
+	const int tiles_x = (static_cast<int>(width) + tile - 1) / tile;
+	const int num_tiles = static_cast<int>(in_bins.size());
+
+	// Every tile owns its pixels and depth tiles, so tiles don't need any
+	// synchronization
+	size_t tested_tiles = 0;
+	size_t culled_tiles = 0;
+	size_t shaded_fragments = 0;
+	size_t passed_samples = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+ : tested_tiles, culled_tiles, shaded_fragments, passed_samples)
+	for (int tile_id = 0; tile_id < num_tiles; tile_id++)
+	{
+		draw_statistics tile_statistics;
+
+		int2 tile_begin{ (tile_id % tiles_x) * tile, (tile_id / tiles_x) * tile };
+		int2 tile_end{
+			std::min(tile_begin.x + tile, static_cast<int>(width)) - 1,
+			std::min(tile_begin.y + tile, static_cast<int>(height)) - 1
+		};
+
+		for (int primitive_id : in_bins[tile_id])
+		{
+			rasterize_primitive(in_primitives[primitive_id], tile_begin, tile_end, tile_statistics);
+		}
+
+		tested_tiles += tile_statistics.tested_tiles;
+		culled_tiles += tile_statistics.culled_tiles;
+		shaded_fragments += tile_statistics.shaded_fragments;
+		passed_samples += tile_statistics.passed_samples;
+	}
+
+	statistics.tested_tiles += tested_tiles;
+	statistics.culled_tiles += culled_tiles;
+	statistics.shaded_fragments += shaded_fragments;
+	statistics.passed_samples += passed_samples;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::process_vertices(
+	const draw_bindings& in_bindings, size_t vertex_offset, size_t num_vertexes,
+	const unsigned char* referenced, vertex_positions& out_positions)
+{
+	// Skipped vertices stay finite after the projection
+	out_positions.first_vertex = vertex_offset;
+	out_positions.x.assign(num_vertexes, 0.f);
+	out_positions.y.assign(num_vertexes, 0.f);
+	out_positions.z.assign(num_vertexes, 0.f);
+	out_positions.w.assign(num_vertexes, 1.f);
+	out_positions.screen_x.resize(num_vertexes);
+	out_positions.screen_y.resize(num_vertexes);
+	out_positions.screen_z.resize(num_vertexes);
+
+	const int num_chunks =
+		static_cast<int>((num_vertexes + vertex_chunk_size - 1) / vertex_chunk_size);
+
+#pragma omp parallel for if (in_bindings.parallel)
+	for (int chunk = 0; chunk < num_chunks; chunk++)
+	{
+		size_t begin = static_cast<size_t>(chunk) * vertex_chunk_size;
+		size_t end = std::min(begin + vertex_chunk_size, num_vertexes);
+
+		for (size_t i = begin; i < end; i++)
+		{
+			if (referenced && !referenced[i])
+				continue;
+
+			const VB& vertex = in_bindings.vertices[vertex_offset + i];
+			float4 coords{ vertex.x, vertex.y, vertex.z, 1.f };
+			float4 position = (*in_bindings.vertex_shader)(coords, vertex).first;
+
+			out_positions.x[i] = position.x;
+			out_positions.y[i] = position.y;
+			out_positions.z[i] = position.z;
+			out_positions.w[i] = position.w;
+		}
+
+		project_positions(out_positions, begin, end);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::project_positions(
+	vertex_positions& in_out_positions, size_t begin, size_t end)
+{
+	const float* x = in_out_positions.x.data();
+	const float* y = in_out_positions.y.data();
+	const float* z = in_out_positions.z.data();
+	const float* w = in_out_positions.w.data();
+	float* screen_x = in_out_positions.screen_x.data();
+	float* screen_y = in_out_positions.screen_y.data();
+	float* screen_z = in_out_positions.screen_z.data();
+	const float viewport_width = static_cast<float>(width);
+	const float viewport_height = static_cast<float>(height);
+
+	size_t i = begin;
+
+#ifdef CG_RASTERIZER_SSE
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 width_4 = _mm_set1_ps(viewport_width);
+	const __m128 height_4 = _mm_set1_ps(viewport_height);
+
+	for (; i + 4 <= end; i += 4)
+	{
+		// Back to cartesian
+		__m128 w_4 = _mm_loadu_ps(w + i);
+		__m128 x_4 = _mm_div_ps(_mm_loadu_ps(x + i), w_4);
+		__m128 y_4 = _mm_div_ps(_mm_loadu_ps(y + i), w_4);
+		__m128 z_4 = _mm_div_ps(_mm_loadu_ps(z + i), w_4);
+
+		x_4 = _mm_div_ps(_mm_mul_ps(_mm_add_ps(x_4, one), width_4), two);
+		y_4 = _mm_div_ps(_mm_mul_ps(_mm_sub_ps(one, y_4), height_4), two);
+
+		_mm_storeu_ps(screen_x + i, x_4);
+		_mm_storeu_ps(screen_y + i, y_4);
+		_mm_storeu_ps(screen_z + i, z_4);
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		// Back to cartesian
+		screen_x[i] = x[i] / w[i];
+		screen_y[i] = y[i] / w[i];
+		screen_z[i] = z[i] / w[i];
+
+		screen_x[i] = (screen_x[i] + 1.f) * viewport_width / 2.f;
+		screen_y[i] = (-screen_y[i] + 1.f) * viewport_height / 2.f;
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline VB rasterizer<VB, RT, VS, PS>::fetch_vertex(
+	const draw_bindings& in_bindings, const vertex_positions& in_positions, size_t vertex_id)
+{
+	size_t position_id = vertex_id - in_positions.first_vertex;
+
+	VB vertex = in_bindings.vertices[vertex_id];
+	vertex.x = in_positions.screen_x[position_id];
+	vertex.y = in_positions.screen_y[position_id];
+	vertex.z = in_positions.screen_z[position_id];
+	return vertex;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::assemble_primitive(
+	const draw_bindings& in_bindings, const vertex_positions& in_positions,
+	const size_t* vertex_ids, primitive& out_primitive, primitive_list& out_clipped_primitives)
+{
+	clip_vertex vertices[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		size_t position_id = vertex_ids[i] - in_positions.first_vertex;
+		vertices[i].position = float4{
+			in_positions.x[position_id], in_positions.y[position_id],
+			in_positions.z[position_id], in_positions.w[position_id]
+		};
+		out_primitive.inv_w[i] = 1.f / vertices[i].position.w;
+	}
+
+	// Trivial reject: all vertices are outside of the same frustum plane
+	const float2 frustum_extent{ 1.f, 1.f };
+	if (get_outcode(vertices[0].position, frustum_extent) &
+		get_outcode(vertices[1].position, frustum_extent) &
+		get_outcode(vertices[2].position, frustum_extent))
+	{
+		out_primitive.visible = false;
+		return;
+	}
+
+	// Only the near plane and the guard band are clipped, the rest of the
+	// frustum is left to the scissoring by the bounding box
+	const float2 guard_band_extent = get_guard_band_extent();
+	unsigned clip_planes = 0;
+	for (size_t i = 0; i < 3; i++)
+		clip_planes |= get_outcode(vertices[i].position, guard_band_extent) & ~clip_far;
+
+	if (clip_planes == 0)
+	{
+		for (size_t i = 0; i < 3; i++)
+			out_primitive.vertices[i] = fetch_vertex(in_bindings, in_positions, vertex_ids[i]);
+		setup_primitive(out_primitive);
+		return;
+	}
+
+	out_primitive.visible = false;
+	for (size_t i = 0; i < 3; i++)
+		vertices[i].data = in_bindings.vertices[vertex_ids[i]];
+	clip_primitive(vertices, clip_planes, guard_band_extent, out_clipped_primitives);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::clip_primitive(
+	const clip_vertex* in_vertices, unsigned clip_planes, float2 guard_band_extent,
+	primitive_list& out_primitives)
+{
+	// Sutherland-Hodgman in clip space, so the attributes are interpolated
+	// linearly before the perspective division
+	clip_vertex buffers[2][max_clipped_vertices];
+	clip_vertex* polygon = buffers[0];
+	clip_vertex* clipped = buffers[1];
+	int num_vertices = 3;
+	for (int i = 0; i < 3; i++)
+		polygon[i] = in_vertices[i];
+
+	for (unsigned plane = clip_near; plane <= clip_top; plane <<= 1)
+	{
+		if (!(clip_planes & plane) || num_vertices == 0)
+			continue;
+
+		// Signed distance, the inside is positive
+		auto distance = [&](const float4& position) {
+			switch (plane)
+			{
+				case clip_near:
+					return position.z;
+				case clip_left:
+					return position.x + guard_band_extent.x * position.w;
+				case clip_right:
+					return guard_band_extent.x * position.w - position.x;
+				case clip_bottom:
+					return position.y + guard_band_extent.y * position.w;
+				default:
+					return guard_band_extent.y * position.w - position.y;
+			}
+		};
+
+		int num_clipped = 0;
+		for (int i = 0; i < num_vertices; i++)
+		{
+			const clip_vertex& a = polygon[i];
+			const clip_vertex& b = polygon[(i + 1) % num_vertices];
+			float distance_a = distance(a.position);
+			float distance_b = distance(b.position);
+
+			if (distance_a >= 0.f)
+				clipped[num_clipped++] = a;
+
+			if ((distance_a >= 0.f) != (distance_b >= 0.f))
+			{
+				float t = distance_a / (distance_a - distance_b);
+				clip_vertex& intersection = clipped[num_clipped++];
+				intersection.position = a.position + (b.position - a.position) * t;
+				intersection.data = cg::interpolate_bary(a.data, b.data, b.data, 1.f - t, t, 0.f);
+			}
+		}
+
+		std::swap(polygon, clipped);
+		num_vertices = num_clipped;
+	}
+
+	// Triangle fan keeps the winding of the input triangle
+	for (int i = 1; i + 1 < num_vertices; i++)
+	{
+		primitive primitive;
+		primitive.vertices[0] = project_vertex(polygon[0]);
+		primitive.vertices[1] = project_vertex(polygon[i]);
+		primitive.vertices[2] = project_vertex(polygon[i + 1]);
+		primitive.inv_w[0] = 1.f / polygon[0].position.w;
+		primitive.inv_w[1] = 1.f / polygon[i].position.w;
+		primitive.inv_w[2] = 1.f / polygon[i + 1].position.w;
+		setup_primitive(primitive);
+		if (primitive.visible)
+			out_primitives.push_back(primitive);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::merge_clipped_primitives(
+	primitive_list& in_out_primitives, std::pmr::vector<primitive_list>& in_clipped_primitives)
+{
+	// Clipped parts replace their triangle, so the submission order is kept
+	size_t num_clipped = 0;
+	for (const auto& clipped : in_clipped_primitives)
+		num_clipped += clipped.size();
+	if (num_clipped == 0)
+		return;
+
+	primitive_list merged(in_out_primitives.get_allocator());
+	merged.reserve(in_out_primitives.size() + num_clipped);
+	for (size_t i = 0; i < in_out_primitives.size(); i++)
+	{
+		if (in_out_primitives[i].visible)
+			merged.push_back(in_out_primitives[i]);
+		merged.insert(
+			merged.end(), in_clipped_primitives[i].begin(), in_clipped_primitives[i].end());
+	}
+	in_out_primitives.swap(merged);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline unsigned rasterizer<VB, RT, VS, PS>::get_outcode(const float4& position, float2 extent)
+{
+	unsigned outcode = 0;
+	if (position.z < 0.f)
+		outcode |= clip_near;
+	if (position.z > position.w)
+		outcode |= clip_far;
+	if (position.x < -extent.x * position.w)
+		outcode |= clip_left;
+	if (position.x > extent.x * position.w)
+		outcode |= clip_right;
+	if (position.y < -extent.y * position.w)
+		outcode |= clip_bottom;
+	if (position.y > extent.y * position.w)
+		outcode |= clip_top;
+	return outcode;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline float2 rasterizer<VB, RT, VS, PS>::get_guard_band_extent()
+{
+	// |x / w| <= extent.x keeps the screen x within [-guard_band, guard_band]
+	return float2{ 2.f * guard_band / static_cast<float>(width) - 1.f,
+				   2.f * guard_band / static_cast<float>(height) - 1.f };
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline VB rasterizer<VB, RT, VS, PS>::project_vertex(const clip_vertex& in_vertex)
+{
+	// Same as project_positions
+	VB vertex = in_vertex.data;
+	vertex.x = in_vertex.position.x / in_vertex.position.w;
+	vertex.y = in_vertex.position.y / in_vertex.position.w;
+	vertex.z = in_vertex.position.z / in_vertex.position.w;
+
+	vertex.x = (vertex.x + 1.f) * static_cast<float>(width) / 2.f;
+	vertex.y = (-vertex.y + 1.f) * static_cast<float>(height) / 2.f;
+	return vertex;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::setup_primitive(primitive& out_primitive)
+{
+	const VB* vertices = out_primitive.vertices;
+
+	// Triangle setup in sub-pixel fixed point
+	int2 fixed[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		if (!std::isfinite(vertices[i].x) || !std::isfinite(vertices[i].y))
+		{
+			out_primitive.visible = false;
+			return;
+		}
+
+		fixed[i] = int2{
+			static_cast<int>(std::lround(
+				std::clamp(vertices[i].x, -guard_band, guard_band) * subpixel_scale)),
+			static_cast<int>(std::lround(
+				std::clamp(vertices[i].y, -guard_band, guard_band) * subpixel_scale))
+		};
+	}
+
+	// Front-facing triangles have a positive area, degenerate triangles have
+	// no covered pixels
+	int64_t area = static_cast<int64_t>(fixed[2].x - fixed[0].x) * (fixed[1].y - fixed[0].y) -
+				   static_cast<int64_t>(fixed[2].y - fixed[0].y) * (fixed[1].x - fixed[0].x);
+	bool front_facing = area > 0;
+	if (area == 0 || (face_culling == cull_mode::back && !front_facing) ||
+		(face_culling == cull_mode::front && front_facing))
+	{
+		out_primitive.visible = false;
+		return;
+	}
+
+	// Edge equations expect the front-facing winding
+	if (!front_facing)
+	{
+		std::swap(out_primitive.vertices[1], out_primitive.vertices[2]);
+		std::swap(out_primitive.inv_w[1], out_primitive.inv_w[2]);
+		std::swap(fixed[1], fixed[2]);
+		area = -area;
+	}
+	out_primitive.edge = static_cast<float>(area);
+	out_primitive.depth_min = std::min(vertices[0].z, std::min(vertices[1].z, vertices[2].z));
+	out_primitive.depth_max = std::max(vertices[0].z, std::max(vertices[1].z, vertices[2].z));
+
+	// bary for vertices[2], vertices[0] and vertices[1]
+	out_primitive.edges[0] = setup_edge(fixed[0], fixed[1]);
+	out_primitive.edges[1] = setup_edge(fixed[1], fixed[2]);
+	out_primitive.edges[2] = setup_edge(fixed[2], fixed[0]);
+
+	// Pixels are sampled at integer coordinates, multisampled pixels within
+	// half a pixel around them
+	const int sample_extent = sample_count > 1 ? static_cast<int>(subpixel_scale) / 2 : 0;
+	int2 fixed_min = min(fixed[0], min(fixed[1], fixed[2])) - int2{ sample_extent, sample_extent };
+	int2 fixed_max = max(fixed[0], max(fixed[1], fixed[2])) + int2{ sample_extent, sample_extent };
+	int2 subpixel_mask{ static_cast<int>(subpixel_scale) - 1,
+						static_cast<int>(subpixel_scale) - 1 };
+
+	out_primitive.bounding_box_begin = max(
+		int2{ (fixed_min.x + subpixel_mask.x) >> subpixel_bits,
+			  (fixed_min.y + subpixel_mask.y) >> subpixel_bits },
+		int2{ 0, 0 });
+	out_primitive.bounding_box_end = min(
+		int2{ fixed_max.x >> subpixel_bits, fixed_max.y >> subpixel_bits },
+		int2{ static_cast<int>(width) - 1, static_cast<int>(height) - 1 });
+
+	out_primitive.visible =
+		out_primitive.bounding_box_begin.x <= out_primitive.bounding_box_end.x &&
+		out_primitive.bounding_box_begin.y <= out_primitive.bounding_box_end.y;
+
+	if (out_primitive.visible)
+		setup_planes(out_primitive);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::setup_planes(primitive& out_primitive)
+{
+	// Attributes of the vertices are packed once
+	float fields[3][layout::num_planes];
+	for (size_t i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < layout::num_interpolated; j++)
+			fields[i][j] = out_primitive.vertices[i].*layout::members[j];
+		if constexpr (layout::decoded_normal)
+		{
+			float3 normal = cg::vertex_layout<VB>::get_normal(out_primitive.vertices[i]);
+			fields[i][layout::normal_plane] = normal.x;
+			fields[i][layout::normal_plane + 1] = normal.y;
+			fields[i][layout::normal_plane + 2] = normal.z;
+		}
+	}
+
+	if (!smooth_shading)
+	{
+		for (int i = 0; i < layout::inv_w_plane; i++)
+		{
+			out_primitive.planes[i] = {
+				(fields[0][i] + fields[1][i] + fields[2][i]) / 3.f, 0.f, 0.f
+			};
+		}
+		out_primitive.planes[layout::inv_w_plane] = { 1.f, 0.f, 0.f };
+		return;
+	}
+
+	// Barycentrics at the origin and their steps come from the edge equations,
+	// bary for vertices[0], vertices[1] and vertices[2]
+	const int2 origin = out_primitive.bounding_box_begin;
+	const double area = out_primitive.edge;
+	double bary[3], step_x[3], step_y[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		const edge_equation& edge = out_primitive.edges[(i + 1) % 3];
+		int64_t value = edge.c + static_cast<int64_t>(origin.x) * edge.step_x +
+						static_cast<int64_t>(origin.y) * edge.step_y;
+		bary[i] = static_cast<double>(value) / area;
+		step_x[i] = edge.step_x / area;
+		step_y[i] = edge.step_y / area;
+	}
+
+	auto setup_plane = [&](double a0, double a1, double a2) {
+		return attribute_plane{
+			static_cast<float>(bary[0] * a0 + bary[1] * a1 + bary[2] * a2),
+			static_cast<float>(step_x[0] * a0 + step_x[1] * a1 + step_x[2] * a2),
+			static_cast<float>(step_y[0] * a0 + step_y[1] * a1 + step_y[2] * a2)
+		};
+	};
+
+	const float* inv_w = out_primitive.inv_w;
+	for (int i = 0; i < layout::inv_w_plane; i++)
+	{
+		out_primitive.planes[i] =
+			setup_plane(fields[0][i] * inv_w[0], fields[1][i] * inv_w[1], fields[2][i] * inv_w[2]);
+	}
+	out_primitive.planes[layout::inv_w_plane] = setup_plane(inv_w[0], inv_w[1], inv_w[2]);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline typename rasterizer<VB, RT, VS, PS>::edge_equation
+	rasterizer<VB, RT, VS, PS>::setup_edge(int2 a, int2 b)
+{
+	// Same as (p - a) x (b - a) for p = (x, y) * subpixel_scale
+	edge_equation result;
+	result.step_x = static_cast<int32_t>((b.y - a.y) * subpixel_scale);
+	result.step_y = static_cast<int32_t>(-(b.x - a.x) * subpixel_scale);
+	result.c = static_cast<int64_t>(a.y) * (b.x - a.x) - static_cast<int64_t>(a.x) * (b.y - a.y);
+
+	// Top-left fill rule: the interior is below a top edge and to the right
+	// of a left edge
+	bool top_edge = a.y == b.y && b.x < a.x;
+	bool left_edge = b.y > a.y;
+	result.bias = (top_edge || left_edge) ? 0 : -1;
+	return result;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::rasterize_primitive(
+	const primitive& in_primitive, int2 rect_begin, int2 rect_end,
+	draw_statistics& out_statistics)
+{
+	int2 begin = max(in_primitive.bounding_box_begin, rect_begin);
+	int2 end = min(in_primitive.bounding_box_end, rect_end);
+	if (begin.x > end.x || begin.y > end.y)
+		return;
+
+	// Edge offsets of the samples are exact, the steps are multiples of
+	// the sub-pixel scale
+	const auto& positions = sample_positions[sample_count == 8 ? 3 : sample_count / 2];
+	int64_t sample_offsets[max_samples * 3];
+	for (unsigned s = 0; s < sample_count; s++)
+	{
+		for (size_t i = 0; i < 3; i++)
+		{
+			const edge_equation& edge = in_primitive.edges[i];
+			sample_offsets[s * 3 + i] =
+				(positions[s][0] * static_cast<int64_t>(edge.step_x) +
+				 positions[s][1] * static_cast<int64_t>(edge.step_y)) /
+				subpixel_scale;
+		}
+	}
+
+	// Blocks are visited tile by tile, in the order of the elements of tiled
+	// targets. Edge values at the top-left pixel of a tile and of a block are
+	// stepped with integer adds.
+	int2 tile_begin{ begin.x - begin.x % depth_tile_size, begin.y - begin.y % depth_tile_size };
+	int64_t tile_row_edges[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		const edge_equation& edge = in_primitive.edges[i];
+		tile_row_edges[i] = edge.c + static_cast<int64_t>(tile_begin.x) * edge.step_x +
+							static_cast<int64_t>(tile_begin.y) * edge.step_y;
+	}
+
+	for (int tile_y = tile_begin.y; tile_y <= end.y; tile_y += depth_tile_size)
+	{
+		int64_t tile_edges[3] = { tile_row_edges[0], tile_row_edges[1], tile_row_edges[2] };
+
+		for (int tile_x = tile_begin.x; tile_x <= end.x; tile_x += depth_tile_size)
+		{
+			int64_t row_edges[3] = { tile_edges[0], tile_edges[1], tile_edges[2] };
+
+			// Tiles behind their farthest depth are rejected before any of
+			// their coverage is computed
+			const bool occluded =
+				depth_buffer && hierarchical_z &&
+				is_tile_occluded(in_primitive, tile_x / depth_tile_size, tile_y / depth_tile_size);
+			if (depth_buffer && hierarchical_z)
+			{
+				out_statistics.tested_tiles++;
+				out_statistics.culled_tiles += occluded ? 1 : 0;
+			}
+
+			for (int block_y = tile_y; !occluded && block_y < tile_y + depth_tile_size;
+				 block_y += block_size)
+			{
+				int64_t block_edges[3] = { row_edges[0], row_edges[1], row_edges[2] };
+
+				for (int block_x = tile_x; block_x < tile_x + depth_tile_size;
+					 block_x += block_size)
+				{
+					if (block_x + block_size > begin.x && block_x <= end.x &&
+						block_y + block_size > begin.y && block_y <= end.y)
+						rasterize_block(
+							in_primitive, block_x, block_y, block_edges, begin, end,
+							sample_offsets, out_statistics);
+
+					for (size_t i = 0; i < 3; i++)
+						block_edges[i] += block_size * in_primitive.edges[i].step_x;
+				}
+
+				for (size_t i = 0; i < 3; i++)
+					row_edges[i] += block_size * in_primitive.edges[i].step_y;
+			}
+
+			for (size_t i = 0; i < 3; i++)
+				tile_edges[i] += depth_tile_size * in_primitive.edges[i].step_x;
+		}
+
+		for (size_t i = 0; i < 3; i++)
+			tile_row_edges[i] += depth_tile_size * in_primitive.edges[i].step_y;
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::rasterize_block(
+	const primitive& in_primitive, int block_x, int block_y, const int64_t* block_edges,
+	int2 begin, int2 end, const int64_t* sample_offsets, draw_statistics& out_statistics)
+{
+	// A pixel is covered if any of its samples is
+	unsigned sample_coverage[max_samples];
+	unsigned coverage = 0;
+	for (unsigned s = 0; s < sample_count; s++)
+	{
+		const int64_t sample_edges[3] = { block_edges[0] + sample_offsets[s * 3],
+										  block_edges[1] + sample_offsets[s * 3 + 1],
+										  block_edges[2] + sample_offsets[s * 3 + 2] };
+		sample_coverage[s] = evaluate_block(in_primitive, sample_edges);
+		coverage |= sample_coverage[s];
+	}
+
+	// Drop pixels of border blocks which are out of the scanned rectangle
+	if (coverage != 0 &&
+		(block_x < begin.x || block_x + block_size - 1 > end.x ||
+		 block_y < begin.y || block_y + block_size - 1 > end.y))
+	{
+		for (int i = 0; i < block_size; i++)
+		{
+			int y = block_y + i;
+			for (int j = 0; j < block_size; j++)
+			{
+				int x = block_x + j;
+				if (x < begin.x || x > end.x || y < begin.y || y > end.y)
+					coverage &= ~(1u << (i * block_size + j));
+			}
+		}
+	}
+
+	if (coverage != 0)
+	{
+		// Blocks are inside of one depth tile
+		if (depth_buffer &&
+			depth_tiles_cleared_view(block_x / depth_tile_size, block_y / depth_tile_size))
+			fill_tile(block_x / depth_tile_size, block_y / depth_tile_size);
+
+		shade_block(
+			in_primitive, block_x, block_y, block_edges, coverage, sample_coverage,
+			sample_offsets, out_statistics);
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline unsigned rasterizer<VB, RT, VS, PS>::evaluate_block(
+	const primitive& in_primitive, const int64_t* block_edges)
+{
+	unsigned coverage = full_coverage;
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		const edge_equation& edge = in_primitive.edges[i];
+		int64_t value = block_edges[i] + edge.bias;
+
+		// Edge functions are linear, so the extremes are in the block corners
+		int64_t corner_x = static_cast<int64_t>(block_size - 1) * edge.step_x;
+		int64_t corner_y = static_cast<int64_t>(block_size - 1) * edge.step_y;
+		int64_t min_value = value + std::min<int64_t>(corner_x, 0) + std::min<int64_t>(corner_y, 0);
+		int64_t max_value = value + std::max<int64_t>(corner_x, 0) + std::max<int64_t>(corner_y, 0);
+
+		if (max_value < 0)
+			return 0;
+		if (min_value < 0)
+			coverage &= evaluate_edge(edge, value);
+	}
+
+	return coverage;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline unsigned rasterizer<VB, RT, VS, PS>::evaluate_edge(const edge_equation& in_edge, int64_t value)
+{
+	// The edge crosses the block, so the value is bounded by the block steps
+	// and the test could be done in 32 bits
+	unsigned coverage = 0;
+
+#ifdef CG_RASTERIZER_SSE
+	const __m128i threshold = _mm_set1_epi32(static_cast<int32_t>(-value - 1));
+	const __m128i step_y = _mm_set1_epi32(in_edge.step_y);
+	__m128i offsets = _mm_set_epi32(3 * in_edge.step_x, 2 * in_edge.step_x, in_edge.step_x, 0);
+
+	for (int i = 0; i < block_size; i++)
+	{
+		__m128i inside = _mm_cmpgt_epi32(offsets, threshold);
+		coverage |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(inside)))
+					<< (i * block_size);
+		offsets = _mm_add_epi32(offsets, step_y);
+	}
+#else
+	for (int i = 0; i < block_size; i++)
+	{
+		for (int j = 0; j < block_size; j++)
+		{
+			int64_t offset = static_cast<int64_t>(j) * in_edge.step_x +
+							 static_cast<int64_t>(i) * in_edge.step_y;
+			if (value + offset >= 0)
+				coverage |= 1u << (i * block_size + j);
+		}
+	}
+#endif
+
+	return coverage;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::shade_block(
+	const primitive& in_primitive, int x, int y, const int64_t* block_edges,
+	unsigned coverage, const unsigned* sample_coverage, const int64_t* sample_offsets,
+	draw_statistics& out_statistics)
+{
+	const edge_equation* edges = in_primitive.edges;
+	const attribute_plane* planes = in_primitive.planes;
+	int64_t row_edges[3] = { block_edges[0], block_edges[1], block_edges[2] };
+
+	// Attributes are needed only by the passes which run the pixel shader
+	const bool interpolated = pass == raster_pass::color || pass == raster_pass::depth_equal;
+	float row_values[layout::num_planes];
+	if (interpolated)
+		evaluate_planes(in_primitive, x, y, row_values);
+
+	for (int i = 0; i < block_size; i++)
+	{
+		int64_t pixel_edges[3] = { row_edges[0], row_edges[1], row_edges[2] };
+		float pixel_values[layout::num_planes];
+		if (interpolated)
+			std::copy(row_values, row_values + layout::num_planes, pixel_values);
+
+		for (int j = 0; j < block_size; j++)
+		{
+			const unsigned bit = i * block_size + j;
+			if (coverage & (1u << bit))
+			{
+				unsigned samples = 0;
+				for (unsigned s = 0; s < sample_count; s++)
+					samples |= ((sample_coverage[s] >> bit) & 1u) << s;
+
+				shade_fragment(
+					in_primitive, x + j, y + i, pixel_edges, samples, sample_offsets,
+					pixel_values, out_statistics);
+			}
+
+			pixel_edges[0] += edges[0].step_x;
+			pixel_edges[1] += edges[1].step_x;
+			pixel_edges[2] += edges[2].step_x;
+			if (interpolated)
+			{
+				for (int k = 0; k < layout::num_planes; k++)
+					pixel_values[k] += planes[k].step_x;
+			}
+		}
+
+		row_edges[0] += edges[0].step_y;
+		row_edges[1] += edges[1].step_y;
+		row_edges[2] += edges[2].step_y;
+		if (interpolated)
+		{
+			for (int k = 0; k < layout::num_planes; k++)
+				row_values[k] += planes[k].step_y;
+		}
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::shade_fragment(
+	const primitive& in_primitive, int x, int y, const int64_t* pixel_edges,
+	unsigned samples, const int64_t* sample_offsets, const float* plane_values,
+	draw_statistics& out_statistics)
+{
+	float sample_depths[max_samples];
+	unsigned passed = 0;
+	for (unsigned s = 0; s < sample_count; s++)
+	{
+		if (!(samples & (1u << s)))
+			continue;
+
+		const int64_t sample_edges[3] = { pixel_edges[0] + sample_offsets[s * 3],
+										  pixel_edges[1] + sample_offsets[s * 3 + 1],
+										  pixel_edges[2] + sample_offsets[s * 3 + 2] };
+		float z = interpolate_depth(in_primitive, sample_edges);
+		size_t depth_x = x * sample_count + s;
+		if (pass == raster_pass::depth_equal)
+		{
+			// Depth of the visible fragment is already in the depth buffer
+			if (depth_buffer_view(depth_x, y) != z)
+				continue;
+		}
+		else if (!depth_test(z, depth_x, y))
+		{
+			continue;
+		}
+
+		sample_depths[s] = z;
+		passed |= 1u << s;
+		if (pass != raster_pass::depth_equal)
+			out_statistics.passed_samples++;
+	}
+	if (passed == 0)
+		return;
+
+	if (pass == raster_pass::visibility)
+	{
+		for (unsigned s = 0; s < sample_count; s++)
+		{
+			if (passed & (1u << s))
+				primitive_ids_view(x * sample_count + s, y) = visibility_draw_id | in_primitive.id;
+		}
+	}
+	else if (pass != raster_pass::depth_only)
+	{
+		// Multisampled pixels are shaded at the pixel, not at a sample
+		float z = sample_count == 1 ? sample_depths[0] : interpolate_depth(in_primitive, pixel_edges);
+		auto interpolated_vertex = interpolate_planes(in_primitive, plane_values, x, y, z);
+		auto pixel_shader_result = pixel_shader(interpolated_vertex, z);
+		RT color = to_target_color(pixel_shader_result);
+		if (sample_count == 1)
+		{
+			render_target_view(x, y) = color;
+		}
+		else
+		{
+			for (unsigned s = 0; s < sample_count; s++)
+			{
+				if (passed & (1u << s))
+					color_samples_view(x * sample_count + s, y) = color;
+			}
+		}
+		out_statistics.shaded_fragments++;
+	}
+
+	if (depth_buffer && depth_write && pass != raster_pass::depth_equal)
+	{
+		// Passed samples get nearer, so the tile loses the ones which were
+		// at its farthest depth
+		const float tile_max = depth_tiles_view(x / depth_tile_size, y / depth_tile_size);
+		uint32_t& farthest = depth_tiles_farthest_view(x / depth_tile_size, y / depth_tile_size);
+		for (unsigned s = 0; s < sample_count; s++)
+		{
+			if (!(passed & (1u << s)))
+				continue;
+
+			float& depth = depth_buffer_view(x * sample_count + s, y);
+			if (farthest != 0 && depth == tile_max)
+				farthest--;
+			depth = sample_depths[s];
+		}
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline RT rasterizer<VB, RT, VS, PS>::to_target_color(const cg::color& in_color)
+{
+	if constexpr (std::is_same_v<RT, cg::color>)
+		return in_color;
+	else
+		return RT::from_color(in_color);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline float rasterizer<VB, RT, VS, PS>::interpolate_depth(
+	const primitive& in_primitive, const int64_t* edges)
+{
+	const VB* vertices = in_primitive.vertices;
+	float3 barycentric = get_barycentric(in_primitive, edges[0], edges[1], edges[2]);
+
+	// Clamping keeps rounding errors within the depth range of the triangle,
+	// which the hierarchical depth test relies on
+	return std::clamp(
+		barycentric.x * vertices[0].z + barycentric.y * vertices[1].z +
+			barycentric.z * vertices[2].z,
+		in_primitive.depth_min, in_primitive.depth_max);
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline void rasterizer<VB, RT, VS, PS>::evaluate_planes(
+	const primitive& in_primitive, int x, int y, float* out_values)
+{
+	const float offset_x = static_cast<float>(x - in_primitive.bounding_box_begin.x);
+	const float offset_y = static_cast<float>(y - in_primitive.bounding_box_begin.y);
+	for (int i = 0; i < layout::num_planes; i++)
+	{
+		const attribute_plane& plane = in_primitive.planes[i];
+		out_values[i] = plane.origin + offset_x * plane.step_x + offset_y * plane.step_y;
+	}
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline cg::decoded_vertex_t<VB> rasterizer<VB, RT, VS, PS>::interpolate_planes(
+	const primitive& in_primitive, const float* plane_values, int x, int y, float z)
+{
+	cg::decoded_vertex_t<VB> result{};
+
+	// Attributes which are not floats are constant over the primitive
+	layout::attributes::for_each([&](auto member) {
+		if constexpr (!std::is_same_v<decltype(member), float VB::*>)
+		{
+			if (!is_encoded_normal<VB>(member))
+				result.*member = in_primitive.vertices[0].*member;
+		}
+	});
+
+	// One division per pixel, the attributes are multiplied by w
+	const float w = 1.f / plane_values[layout::inv_w_plane];
+	for (int i = 0; i < layout::num_interpolated; i++)
+		result.*layout::members[i] = plane_values[i] * w;
+	if constexpr (layout::decoded_normal)
+	{
+		const float* normal = plane_values + layout::normal_plane;
+		result.normal = float3{ normal[0] * w, normal[1] * w, normal[2] * w };
+	}
+
+	result.x = static_cast<float>(x);
+	result.y = static_cast<float>(y);
+	result.z = z;
+	return result;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline float3 rasterizer<VB, RT, VS, PS>::get_barycentric(
+	const primitive& in_primitive, int64_t edge0, int64_t edge1, int64_t edge2)
+{
+	if (!smooth_shading)
+		return float3{ 0.333f, 0.333f, 0.333f };
+
+	// bary for vertices[0], vertices[1] and vertices[2]
+	const float edge = in_primitive.edge;
+	return float3{ static_cast<float>(edge1) / edge, static_cast<float>(edge2) / edge,
+				   static_cast<float>(edge0) / edge };
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline bool rasterizer<VB, RT, VS, PS>::depth_test(float z, size_t x, size_t y)
+{
+	if (!depth_buffer)
+		return true;
+
+	return depth_buffer_view(x, y) > z;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline float rasterizer<VB, RT, VS, PS>::get_depth_tile_max(int tile_x, int tile_y)
+{
+	float& tile_max = depth_tiles_view(tile_x, tile_y);
+	uint32_t& farthest = depth_tiles_farthest_view(tile_x, tile_y);
+
+	if (farthest == 0)
+	{
+		const size_t tile_width = depth_tile_size * sample_count;
+		const size_t x_begin = tile_x * tile_width;
+		const size_t y_begin = tile_y * depth_tile_size;
+		auto tile = depth_buffer_view.subview(
+			x_begin, y_begin, std::min(tile_width, depth_buffer_view.get_width() - x_begin),
+			std::min<size_t>(depth_tile_size, depth_buffer_view.get_height() - y_begin));
+
+		tile_max = -FLT_MAX;
+		for (size_t y = 0; y < tile.get_height(); y++)
+		{
+			for (float depth : tile.row(y))
+			{
+				if (depth > tile_max)
+				{
+					tile_max = depth;
+					farthest = 0;
+				}
+				farthest += depth == tile_max ? 1 : 0;
+			}
+		}
+	}
+
+	return tile_max;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline bool rasterizer<VB, RT, VS, PS>::is_tile_occluded(
+	const primitive& in_primitive, int tile_x, int tile_y)
+{
+	// The nearest depth of the triangle is behind the whole depth tile.
+	// Fragments at the farthest depth still pass the equal test.
+	const float tile_max = get_depth_tile_max(tile_x, tile_y);
+	return pass == raster_pass::depth_equal ? in_primitive.depth_min > tile_max
+											: in_primitive.depth_min >= tile_max;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline const typename rasterizer<VB, RT, VS, PS>::draw_statistics&
+	rasterizer<VB, RT, VS, PS>::get_statistics() const
+{
+	return statistics;
+}
+
+template<typename VB, typename RT, typename VS, typename PS>
+inline std::shared_ptr<cg::resource<uint32_t>>
+	rasterizer<VB, RT, VS, PS>::get_visibility_buffer() const
+{
+	return primitive_ids;
+}
 } // namespace cg::renderer
\ No newline at end of file
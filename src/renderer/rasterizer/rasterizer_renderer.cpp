@@ -2,20 +2,85 @@
 
 #include "utils/resource_utils.h"
 
+#include <array>
+#include <iostream>
+
 
 void cg::renderer::rasterization_renderer::init()
 {
-	// Load model
+	// Load model. Its scratch memory is reused by the frames.
+	arena = std::make_shared<cg::frame_arena>();
 	model = std::make_shared<cg::world::model>();
+	model->set_arena(arena);
 	model->load_obj(settings->model_path);
+	if (settings->triangle_strips)
+		model->stripify();
 
-	// Create render target
-	render_target = std::make_shared<cg::resource<cg::unsigned_color>>(settings->width, settings->height);
-	camera = std::make_shared<cg::world::camera>();
+	// Bounding boxes of the shapes are only drawn by occlusion queries.
+	// Both windings of every box face, so the proxies are drawn with either
+	// handedness of the world matrix.
+	if (settings->occlusion_queries)
+	{
+		const auto& shapes = model->get_per_shape_bounds();
+		const uint32_t box_faces[6][4] = { { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 },
+										   { 2, 6, 7, 3 }, { 0, 2, 3, 1 }, { 4, 5, 7, 6 } };
+		box_vertex_buffer =
+			std::make_shared<cg::resource<cg::compact_vertex>>(shapes.size() * 8);
+		box_index_buffer = std::make_shared<cg::resource<uint32_t>>(shapes.size() * 72);
+		for (size_t s = 0; s < shapes.size(); s++)
+		{
+			const auto& shape = shapes[s];
+			for (size_t c = 0; c < 8; c++)
+			{
+				cg::compact_vertex& vertex = box_vertex_buffer->item(s * 8 + c);
+				vertex = cg::compact_vertex{};
+				vertex.x = c & 1 ? shape.aabb_max.x : shape.aabb_min.x;
+				vertex.y = c & 2 ? shape.aabb_max.y : shape.aabb_min.y;
+				vertex.z = c & 4 ? shape.aabb_max.z : shape.aabb_min.z;
+			}
 
-	// Create depth buffer
-	depth_buffer =
-		std::make_shared<cg::resource<float>>(settings->width, settings->height);
+			uint32_t* indices = &box_index_buffer->item(s * 72);
+			const uint32_t base = static_cast<uint32_t>(s * 8);
+			for (const auto& face : box_faces)
+			{
+				const uint32_t triangles[12] = { face[0], face[1], face[2], face[0],
+												 face[2], face[3], face[0], face[2],
+												 face[1], face[0], face[3], face[2] };
+				for (uint32_t corner : triangles)
+					*indices++ = base + corner;
+			}
+		}
+	}
+
+	// Create render targets and depth buffer, one depth per sample. Tiled
+	// targets keep a tile of the rasterizer with all of its samples together.
+	// They are cleared or resolved every frame, so they aren't zeroed.
+	// The 8-bit target has the layout of the float one for the resolve.
+	cg::allocation_policy target_policy;
+	target_policy.uninitialized = true;
+	target_policy.huge_pages = true;
+	if (settings->tiled_targets)
+	{
+		const size_t tile =
+			cg::renderer::rasterizer<cg::compact_vertex, cg::color>::target_tile_size;
+		hdr_target = std::make_shared<cg::resource<cg::color>>(
+			settings->width, settings->height, tile, tile, target_policy);
+		render_target = std::make_shared<cg::resource<cg::unsigned_color>>(
+			settings->width, settings->height, tile, tile, target_policy);
+		depth_buffer = std::make_shared<cg::resource<float>>(
+			settings->width * settings->sample_count, settings->height,
+			tile * settings->sample_count, tile, target_policy);
+	}
+	else
+	{
+		hdr_target = std::make_shared<cg::resource<cg::color>>(
+			settings->width, settings->height, target_policy);
+		render_target = std::make_shared<cg::resource<cg::unsigned_color>>(
+			settings->width, settings->height, target_policy);
+		depth_buffer = std::make_shared<cg::resource<float>>(
+			settings->width * settings->sample_count, settings->height, target_policy);
+	}
+	camera = std::make_shared<cg::world::camera>();
 
 	camera->set_height(static_cast<float>(settings->height));
 	camera->set_width(static_cast<float>(settings->width));
@@ -30,15 +95,49 @@ void cg::renderer::rasterization_renderer::init()
 	camera->set_z_far(settings->camera_z_far);
 	camera->set_z_near(settings->camera_z_near);
 
+	tone_mapping.exposure = settings->exposure;
+	tone_mapping.srgb = settings->srgb;
+	if (settings->tone_mapping == "none")
+		tone_mapping.curve = cg::renderer::tone_curve::none;
+	else if (settings->tone_mapping == "reinhard")
+		tone_mapping.curve = cg::renderer::tone_curve::reinhard;
+	else if (settings->tone_mapping == "aces")
+		tone_mapping.curve = cg::renderer::tone_curve::aces;
+	else
+		THROW_ERROR("Tone mapping should be none, reinhard or aces");
+
 	// Create rasterizer
-	rasterizer = std::make_shared<cg::renderer::rasterizer<vertex, cg::unsigned_color>>();
-	rasterizer->set_render_target(render_target, depth_buffer);
-	rasterizer->set_vertex_buffer(model->get_vertex_buffer());
+	rasterizer = std::make_shared<cg::renderer::rasterizer<cg::compact_vertex, cg::color>>();
+	rasterizer->set_render_target(hdr_target, depth_buffer);
+	rasterizer->set_vertex_buffer(model->get_compact_vertex_buffer());
+	rasterizer->set_index_buffer(model->get_index_buffer());
 	rasterizer->set_viewport(settings->width, settings->height);
+	rasterizer->set_arena(arena);
 	rasterizer->smooth_shading = settings->smooth_shading;
+	rasterizer->parallel_vertex_processing = settings->parallel_vertex_processing;
+	rasterizer->tiled_rasterization = settings->tiled_rasterization;
+	rasterizer->tile_size = settings->tile_size;
+	rasterizer->depth_prepass = settings->depth_prepass;
+	rasterizer->visibility_buffer = settings->visibility_buffer;
+	rasterizer->sample_count = settings->sample_count;
+	rasterizer->fast_clear = settings->fast_clear;
 }
 
-void cg::renderer::rasterization_renderer::destroy() {}
+void cg::renderer::rasterization_renderer::destroy()
+{
+	if (!settings->statistics || !rasterizer)
+		return;
+
+	const auto& statistics = rasterizer->get_statistics();
+	std::cout << "Shapes: " << drawn_shapes << " of " << model->get_per_shape_bounds().size()
+			  << " drawn, " << statistics.skipped_draws << " skipped as occluded" << std::endl;
+	std::cout << "Triangles: " << statistics.submitted_triangles << " submitted, "
+			  << statistics.culled_triangles << " culled, " << statistics.clipped_triangles
+			  << " clipped, " << statistics.rasterized_triangles << " rasterized" << std::endl;
+	std::cout << "Shaded fragments: " << statistics.shaded_fragments << std::endl;
+	std::cout << "Transient memory: " << arena->get_capacity() / 1024 << " KB in "
+			  << arena->get_upstream_allocations() << " allocations" << std::endl;
+}
 
 void cg::renderer::rasterization_renderer::update() {}
 
@@ -48,20 +147,77 @@ inline float smoothstep(float edge0, float edge1, float x)
 	return x * x * (3 - 2 * x);
 }
 
+namespace
+{
+// Planes of the clip-space frustum |x| <= w, |y| <= w, 0 <= z <= w moved to
+// the space the matrix is applied to. The inside of a plane is positive.
+std::array<float4, 6> get_frustum_planes(const float4x4& matrix)
+{
+	float4 row_x = matrix.row(0);
+	float4 row_y = matrix.row(1);
+	float4 row_z = matrix.row(2);
+	float4 row_w = matrix.row(3);
+	return { row_w + row_x, row_w - row_x, row_w + row_y,
+			 row_w - row_y, row_z, row_w - row_z };
+}
+
+bool is_shape_visible(
+	const std::array<float4, 6>& planes, const cg::world::model::shape_bounds& bounds)
+{
+	if (bounds.num_indexes == 0)
+		return false;
+
+	for (const float4& plane : planes)
+	{
+		float3 normal = plane.xyz();
+		float3 center = bounds.sphere_center;
+
+		// The sphere is cheaper, the box is tighter
+		if (dot(normal, center) + plane.w < -bounds.sphere_radius * length(normal))
+			return false;
+
+		// The box corner which is the farthest along the plane normal
+		float3 corner{ normal.x >= 0.f ? bounds.aabb_max.x : bounds.aabb_min.x,
+					   normal.y >= 0.f ? bounds.aabb_max.y : bounds.aabb_min.y,
+					   normal.z >= 0.f ? bounds.aabb_max.z : bounds.aabb_min.z };
+		if (dot(normal, corner) + plane.w < 0.f)
+			return false;
+	}
+	return true;
+}
+
+// The faces of the box are clipped by the near plane when the camera is
+// close to it, so the box doesn't tell if the shape is hidden
+bool is_camera_inside(
+	const cg::world::model::shape_bounds& bounds, const float3& position, float z_near)
+{
+	float3 box_min = bounds.aabb_min - float3{ z_near, z_near, z_near };
+	float3 box_max = bounds.aabb_max + float3{ z_near, z_near, z_near };
+	return position.x >= box_min.x && position.y >= box_min.y && position.z >= box_min.z &&
+		   position.x <= box_max.x && position.y <= box_max.y && position.z <= box_max.z;
+}
+} // namespace
+
 void cg::renderer::rasterization_renderer::render()
 {
+	// Nothing outlives the previous frame in the arena
+	arena->reset();
+
 	float4x4 matrix =
 		mul(camera->get_projection_matrix(), camera->get_view_matrix(),
 			model->get_world_matrix());
-	rasterizer->vertex_shader = [&](float4 vertex, cg::vertex vertex_data) {
+	const auto materials = model->get_materials();
+	rasterizer->vertex_shader = [&](float4 vertex, cg::compact_vertex vertex_data) {
 		auto processed_vertex = mul(matrix, vertex);
 		return std::make_pair(processed_vertex, vertex_data);
 	};
-	rasterizer->pixel_shader = [&](cg::vertex vertex_data, float z) {
-		/*return cg::color{ vertex_data.diffuse_r,
-						  vertex_data.diffuse_g,
-						  vertex_data.diffuse_b};*/
-		float3 normal = float3{ vertex_data.nx, vertex_data.ny, vertex_data.nz};
+	rasterizer->pixel_shader = [&](const cg::decoded_vertex<cg::compact_vertex>& vertex_data,
+									float z) {
+		const cg::material& material = (*materials)[vertex_data.material_id];
+		/*return cg::color{ material.diffuse.x,
+						  material.diffuse.y,
+						  material.diffuse.z};*/
+		float3 normal = normalize(cg::vertex_layout<cg::compact_vertex>::get_normal(vertex_data));
 		float3 light_direction = normalize(float3(-0.5f, -1.f, -0.5f));
 		float3 towards_light_direction = -light_direction;
 		float3 view = -camera->get_direction();
@@ -71,12 +227,77 @@ void cg::renderer::rasterization_renderer::render()
 		// clamp
 		diffuse = std::clamp(diffuse, 0.f, 1.f);
 
-		return cg::color{ std::clamp(vertex_data.diffuse_r * diffuse + vertex_data.ambient_r * 0.1f, 0.f, 1.f),
-				std::clamp(vertex_data.diffuse_g * diffuse + vertex_data.ambient_g * 0.1f, 0.f, 1.f),
-				std::clamp(vertex_data.diffuse_b * diffuse + vertex_data.ambient_b * 0.1f, 0.f, 1.f)
+		// Linear colors above one are kept for the tone mapping
+		return cg::color{ std::max(material.diffuse.x * diffuse + material.ambient.x * 0.1f, 0.f),
+				std::max(material.diffuse.y * diffuse + material.ambient.y * 0.1f, 0.f),
+				std::max(material.diffuse.z * diffuse + material.ambient.z * 0.1f, 0.f)
 		};
 	};
-	rasterizer->clear_render_target({50, 200, 240});
-	rasterizer->draw(model->get_vertex_buffer()->get_number_of_elements(), 0);
-	cg::utils::save_resource(*render_target, settings->result_path);
+	// Sky blue, {50, 200, 240} after the resolve without a curve
+	if (tone_mapping.srgb)
+		rasterizer->clear_render_target({ 0.0319f, 0.5776f, 0.8714f });
+	else
+		rasterizer->clear_render_target({ 50.5f / 255.f, 200.5f / 255.f, 240.5f / 255.f });
+
+	// Shapes outside of the view frustum are skipped as a whole
+	const auto planes = get_frustum_planes(matrix);
+	const auto& shapes = model->get_per_shape_bounds();
+	drawn_shapes = 0;
+
+	// Camera in the object space of the bounding boxes
+	const float3 camera_position =
+		mul(inverse(model->get_world_matrix()), float4{ camera->get_position(), 1.f }).xyz();
+
+	// Shapes are recorded, then drawn front-to-back. With occlusion queries
+	// the bounding box of a shape is tested first and the shape is drawn
+	// only if some of the box is in front of the shapes drawn before it.
+	commands.reset();
+	commands.vertex_shader = rasterizer->vertex_shader;
+	commands.pixel_shader = rasterizer->pixel_shader;
+	auto shape_index_buffer = model->get_index_buffer();
+	auto shape_topology = cg::renderer::primitive_topology::triangle_list;
+	if (settings->triangle_strips)
+	{
+		shape_index_buffer = model->get_strip_index_buffer();
+		shape_topology = cg::renderer::primitive_topology::triangle_strip;
+	}
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		const auto& shape = shapes[s];
+		if (!is_shape_visible(planes, shape))
+			continue;
+
+		const bool query = settings->occlusion_queries &&
+						   !is_camera_inside(shape, camera_position, settings->camera_z_near);
+		if (query)
+		{
+			commands.set_vertex_buffer(box_vertex_buffer);
+			commands.set_index_buffer(box_index_buffer);
+			commands.topology = cg::renderer::primitive_topology::triangle_list;
+			commands.color_write = false;
+			commands.depth_write = false;
+			commands.begin_query(s);
+			commands.draw_indexed(72, s * 72);
+			commands.end_query();
+			commands.color_write = true;
+			commands.depth_write = true;
+			commands.set_predicate(s);
+		}
+
+		commands.set_vertex_buffer(model->get_compact_vertex_buffer());
+		commands.set_index_buffer(shape_index_buffer);
+		commands.topology = shape_topology;
+		if (settings->triangle_strips)
+			commands.draw_indexed(shape.num_strip_indexes, shape.strip_index_offset);
+		else
+			commands.draw_indexed(shape.num_indexes, shape.index_offset);
+		commands.set_predicate(cg::renderer::no_query);
+		drawn_shapes++;
+	}
+	rasterizer->execute(commands);
+	rasterizer->resolve();
+	// Tiles which no shape touched are still at the clear color
+	rasterizer->resolve_clear();
+	cg::renderer::resolve_tone_mapping(*hdr_target, *render_target, tone_mapping);
+	cg::utils::save_resource(*render_target, settings->result_path, *arena);
 }
\ No newline at end of file
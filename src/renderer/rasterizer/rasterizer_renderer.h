@@ -1,4 +1,5 @@
 #include "renderer/rasterizer/rasterizer.h"
+#include "renderer/rasterizer/tone_mapping.h"
 #include "renderer/renderer.h"
 #include "resource.h"
 
@@ -15,9 +16,24 @@ public:
 	virtual void render();
 
 protected:
+	// Draws write linear colors to the float target, which is tone mapped
+	// into the 8-bit one after all of them
+	std::shared_ptr<cg::resource<cg::color>> hdr_target;
 	std::shared_ptr<cg::resource<cg::unsigned_color>> render_target;
 	std::shared_ptr<cg::resource<float>> depth_buffer;
+	cg::renderer::tone_mapping tone_mapping;
 
-	std::shared_ptr<cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>> rasterizer;
+	std::shared_ptr<cg::renderer::rasterizer<cg::compact_vertex, cg::color>> rasterizer;
+	// Recorded again every frame, the storage of the commands is reused
+	cg::renderer::command_list<cg::compact_vertex> commands;
+	// Of the last frame, printed by destroy with --statistics
+	size_t drawn_shapes = 0;
+
+	// Scratch memory of the model loader and of the frames
+	std::shared_ptr<cg::frame_arena> arena;
+
+	// Bounding boxes of the shapes, drawn as occlusion query proxies
+	std::shared_ptr<cg::resource<cg::compact_vertex>> box_vertex_buffer;
+	std::shared_ptr<cg::resource<uint32_t>> box_index_buffer;
 };
 } // namespace cg::renderer
\ No newline at end of file
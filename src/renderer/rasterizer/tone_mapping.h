@@ -0,0 +1,243 @@
+#pragma once
+
+#include "resource.h"
+#include "utils/simd.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+namespace cg::renderer
+{
+enum class tone_curve
+{
+	// Clamped to [0, 1]
+	none,
+	// x / (1 + x)
+	reinhard,
+	// Fit of the ACES filmic curve by Krzysztof Narkowicz
+	aces
+};
+
+// The defaults resolve the colors as 8-bit targets store them
+struct tone_mapping
+{
+	// Linear colors are scaled before the curve
+	float exposure = 1.f;
+	tone_curve curve = tone_curve::none;
+	// Encodes the result with the sRGB transfer function through a table,
+	// otherwise the result is truncated as cg::unsigned_color::from_color does
+	bool srgb = false;
+};
+
+// Resolves a float render target into an 8-bit one, once per pixel after
+// all of the draws. Lazily cleared tiles should be resolved before. Both
+// targets should have the same size and tiling, so the storage is walked
+// in the order of the memory. The padding of tiled targets is skipped.
+inline void resolve_tone_mapping(
+	cg::resource<cg::color>& in_hdr_target, cg::resource<cg::unsigned_color>& out_target,
+	const tone_mapping& in_settings = {});
+
+namespace detail
+{
+// Linear values in [0, 1] are quantized to 12 bits before the table
+constexpr int srgb_table_bits = 12;
+constexpr int srgb_table_size = 1 << srgb_table_bits;
+
+inline const std::array<unsigned char, srgb_table_size>& get_srgb_table()
+{
+	static const std::array<unsigned char, srgb_table_size> table = []() {
+		std::array<unsigned char, srgb_table_size> values{};
+		for (int i = 0; i < srgb_table_size; i++)
+		{
+			float linear = static_cast<float>(i) / (srgb_table_size - 1);
+			float encoded = linear <= 0.0031308f
+								? 12.92f * linear
+								: 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+			values[i] = static_cast<unsigned char>(std::clamp(encoded, 0.f, 1.f) * 255.f + 0.5f);
+		}
+		return values;
+	}();
+	return table;
+}
+
+inline float apply_tone_curve(float value, tone_curve curve)
+{
+	switch (curve)
+	{
+		case tone_curve::reinhard:
+			return value / (1.f + value);
+		case tone_curve::aces:
+			return value * (2.51f * value + 0.03f) / (value * (2.43f * value + 0.59f) + 0.14f);
+		default:
+			return value;
+	}
+}
+
+// Channels are independent, so the kernels don't care which channel of
+// which pixel a float is
+inline unsigned char resolve_channel(float value, const tone_mapping& in_settings)
+{
+	value = apply_tone_curve(std::max(value * in_settings.exposure, 0.f), in_settings.curve);
+	// NaN is resolved to zero as in the SIMD kernel
+	value = std::min(std::max(value, 0.f), 1.f);
+	if (!(value >= 0.f))
+		value = 0.f;
+	if (in_settings.srgb)
+		return get_srgb_table()[static_cast<int>(value * (srgb_table_size - 1) + 0.5f)];
+	return static_cast<unsigned char>(value * 255.f);
+}
+
+#ifdef CG_RASTERIZER_SSE
+inline __m128 apply_tone_curve(__m128 value, tone_curve curve)
+{
+	switch (curve)
+	{
+		case tone_curve::reinhard:
+			return _mm_div_ps(value, _mm_add_ps(_mm_set1_ps(1.f), value));
+		case tone_curve::aces:
+		{
+			__m128 numerator = _mm_mul_ps(
+				value, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), value), _mm_set1_ps(0.03f)));
+			__m128 denominator = _mm_add_ps(
+				_mm_mul_ps(
+					value, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), value), _mm_set1_ps(0.59f))),
+				_mm_set1_ps(0.14f));
+			return _mm_div_ps(numerator, denominator);
+		}
+		default:
+			return value;
+	}
+}
+
+// 16 channels, e.g. 5 pixels and a channel of the next one
+inline void resolve_channels_16(
+	const float* in_values, unsigned char* out_values, const tone_mapping& in_settings)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 exposure = _mm_set1_ps(in_settings.exposure);
+	const __m128 scale = _mm_set1_ps(in_settings.srgb ? srgb_table_size - 1 : 255.f);
+
+	__m128i quantized[4];
+	for (int i = 0; i < 4; i++)
+	{
+		__m128 value = _mm_mul_ps(_mm_loadu_ps(in_values + 4 * i), exposure);
+		// max and min return the second operand for NaN
+		value = apply_tone_curve(_mm_max_ps(value, zero), in_settings.curve);
+		value = _mm_min_ps(_mm_max_ps(value, zero), one);
+		value = _mm_mul_ps(value, scale);
+		if (in_settings.srgb)
+			value = _mm_add_ps(value, _mm_set1_ps(0.5f));
+		quantized[i] = _mm_cvttps_epi32(value);
+	}
+
+	if (in_settings.srgb)
+	{
+		// SSE2 has no gather
+		alignas(16) int32_t indices[16];
+		for (int i = 0; i < 4; i++)
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices) + i, quantized[i]);
+		const auto& table = get_srgb_table();
+		for (int i = 0; i < 16; i++)
+			out_values[i] = table[indices[i]];
+		return;
+	}
+
+	__m128i packed = _mm_packus_epi16(
+		_mm_packs_epi32(quantized[0], quantized[1]), _mm_packs_epi32(quantized[2], quantized[3]));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out_values), packed);
+}
+#endif
+
+inline void resolve_channels(
+	const float* in_values, unsigned char* out_values, size_t num_channels,
+	const tone_mapping& in_settings)
+{
+	size_t i = 0;
+
+#ifdef CG_RASTERIZER_SSE
+	for (; i + 16 <= num_channels; i += 16)
+		resolve_channels_16(in_values + i, out_values + i, in_settings);
+#endif
+
+	for (; i < num_channels; i++)
+		out_values[i] = resolve_channel(in_values[i], in_settings);
+}
+} // namespace detail
+
+inline void resolve_tone_mapping(
+	cg::resource<cg::color>& in_hdr_target, cg::resource<cg::unsigned_color>& out_target,
+	const tone_mapping& in_settings)
+{
+	static_assert(sizeof(cg::color) == 3 * sizeof(float), "Colors should be packed");
+	static_assert(sizeof(cg::unsigned_color) == 3, "Colors should be packed");
+
+	if (in_hdr_target.get_stride() != out_target.get_stride() ||
+		in_hdr_target.get_number_of_elements() != out_target.get_number_of_elements() ||
+		in_hdr_target.is_tiled() != out_target.is_tiled() ||
+		in_hdr_target.get_tile_width() != out_target.get_tile_width() ||
+		in_hdr_target.get_tile_height() != out_target.get_tile_height())
+		THROW_ERROR("Render targets of the resolve should have the same layout");
+
+	if (!in_hdr_target.is_tiled())
+	{
+		// Linear targets have no padding
+		const cg::span<cg::color> hdr = in_hdr_target.get_span();
+		const cg::span<cg::unsigned_color> ldr = out_target.get_span();
+		const float* values = reinterpret_cast<const float*>(hdr.data);
+		unsigned char* channels = reinterpret_cast<unsigned char*>(ldr.data);
+		const size_t num_channels = hdr.size * 3;
+
+		// Chunks of channels are resolved in parallel
+		constexpr size_t chunk_size = 64 * 1024;
+		const int num_chunks = static_cast<int>((num_channels + chunk_size - 1) / chunk_size);
+
+#pragma omp parallel for
+		for (int chunk = 0; chunk < num_chunks; chunk++)
+		{
+			size_t begin = static_cast<size_t>(chunk) * chunk_size;
+			size_t end = std::min(begin + chunk_size, num_channels);
+			detail::resolve_channels(values + begin, channels + begin, end - begin, in_settings);
+		}
+		return;
+	}
+
+	// Padding of the border tiles is never drawn to and may hold any
+	// floats, e.g. of an uninitialized target, so only the pixels are read
+	const cg::resource_view<cg::color> hdr = in_hdr_target.get_view();
+	const cg::resource_view<cg::unsigned_color> ldr = out_target.get_view();
+	const size_t width = hdr.get_width();
+	const size_t height = hdr.get_height();
+	const size_t tile_width = in_hdr_target.get_tile_width();
+	const size_t tile_height = in_hdr_target.get_tile_height();
+	const size_t tiles_x = (width + tile_width - 1) / tile_width;
+	const size_t tiles_y = (height + tile_height - 1) / tile_height;
+	const int num_tiles = static_cast<int>(tiles_x * tiles_y);
+
+	// Tiles are resolved in parallel
+#pragma omp parallel for
+	for (int tile = 0; tile < num_tiles; tile++)
+	{
+		const size_t x = (static_cast<size_t>(tile) % tiles_x) * tile_width;
+		const size_t y = (static_cast<size_t>(tile) / tiles_x) * tile_height;
+		const size_t rect_width = std::min(tile_width, width - x);
+		const size_t rect_height = std::min(tile_height, height - y);
+		const cg::resource_view<cg::color> hdr_tile = hdr.subview(x, y, rect_width, rect_height);
+		const cg::resource_view<cg::unsigned_color> ldr_tile =
+			ldr.subview(x, y, rect_width, rect_height);
+
+		// Rows of a tile without padding on the right are one run
+		const size_t num_runs = rect_width == tile_width ? 1 : rect_height;
+		const size_t run_length = rect_width == tile_width ? rect_width * rect_height : rect_width;
+		for (size_t run = 0; run < num_runs; run++)
+		{
+			detail::resolve_channels(
+				reinterpret_cast<const float*>(hdr_tile.row(run).data),
+				reinterpret_cast<unsigned char*>(ldr_tile.row(run).data), run_length * 3,
+				in_settings);
+		}
+	}
+}
+} // namespace cg::renderer
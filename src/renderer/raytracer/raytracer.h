@@ -2,6 +2,7 @@
 
 #include "resource.h"
 
+#include <functional>
 #include <linalg.h>
 #include <memory>
 #include <omp.h>
@@ -32,7 +33,10 @@ struct payload
 template<typename VB>
 struct triangle
 {
-	triangle(const VB& vertex_a, const VB& vertex_b, const VB& vertex_c);
+	// Material colors of compact vertices come from the material table
+	triangle(
+		const VB& vertex_a, const VB& vertex_b, const VB& vertex_c,
+		const cg::material* in_materials = nullptr);
 
 	float3 a;
 	float3 b;
@@ -51,34 +55,27 @@ struct triangle
 };
 
 template<typename VB>
-inline triangle<VB>::triangle(const VB& vertex_a, const VB& vertex_b, const VB& vertex_c)
+inline triangle<VB>::triangle(
+	const VB& vertex_a, const VB& vertex_b, const VB& vertex_c, const cg::material* in_materials)
 {
-	a = float3{ vertex_a.x, vertex_a.y, vertex_a.z };
-	b = float3{ vertex_b.x, vertex_b.y, vertex_b.z };
-	c = float3{ vertex_c.x, vertex_c.y, vertex_c.z };
+	using layout = cg::vertex_layout<VB>;
+	using position = typename layout::position;
+
+	a = position::template load<float3>(vertex_a);
+	b = position::template load<float3>(vertex_b);
+	c = position::template load<float3>(vertex_c);
 
 	ba = b - a;
 	ca = c - a;
 
-	na = float3{ vertex_a.nx, vertex_a.ny, vertex_a.nz };
-	nb = float3{ vertex_b.nx, vertex_b.ny, vertex_b.nz };
-	nc = float3{ vertex_c.nx, vertex_c.ny, vertex_c.nz };
-
-	ambient = {
-		vertex_a.ambient_r,
-		vertex_a.ambient_g,
-		vertex_a.ambient_b,
-	};
-	diffuse = {
-		vertex_a.diffuse_r,
-		vertex_a.diffuse_g,
-		vertex_a.diffuse_b,
-	};
-	emissive = {
-		vertex_a.emissive_r,
-		vertex_a.emissive_g,
-		vertex_a.emissive_b,
-	};
+	na = layout::get_normal(vertex_a);
+	nb = layout::get_normal(vertex_b);
+	nc = layout::get_normal(vertex_c);
+
+	cg::material material = layout::get_material(vertex_a, in_materials);
+	ambient = material.ambient;
+	diffuse = material.diffuse;
+	emissive = material.emissive;
 }
 
 template<typename VB>
@@ -102,11 +99,23 @@ struct light
 	float3 color;
 };
 
-template<typename VB, typename RT>
+// Miss and hit shader types may be replaced with functors to let the
+// compiler inline them into trace_ray
+using miss_shader_function = std::function<payload(const ray& ray)>;
+template<typename VB>
+using hit_shader_function =
+	std::function<payload(const ray& ray, payload& payload, const triangle<VB>& triangle)>;
+
+template<
+	typename VB, typename RT, typename MS = miss_shader_function,
+	typename CHS = hit_shader_function<VB>, typename AHS = hit_shader_function<VB>>
 class raytracer
 {
 public:
 	raytracer(){};
+	raytracer(MS in_miss_shader, CHS in_closest_hit_shader, AHS in_any_hit_shader) :
+	miss_shader(in_miss_shader), closest_hit_shader(in_closest_hit_shader),
+	any_hit_shader(in_any_hit_shader){};
 	~raytracer(){};
 
 	void set_render_target(std::shared_ptr<resource<RT>> in_render_target);
@@ -115,6 +124,8 @@ public:
 
 	void set_per_shape_vertex_buffer(
 		std::vector<std::shared_ptr<cg::resource<VB>>> in_per_shape_vertex_buffer);
+	// Required for compact vertices
+	void set_materials(std::shared_ptr<std::vector<cg::material>> in_materials);
 	void build_acceleration_structure();
 	std::vector<aabb<VB>> acceleration_structures;
 
@@ -123,16 +134,15 @@ public:
 	payload trace_ray(const ray& ray, size_t depth, float max_t = 1000.f, float min_t = 0.001f) const;
 	payload intersection_shader(const triangle<VB>& triangle, const ray& ray) const;
 
-	std::function<payload(const ray& ray)> miss_shader = nullptr;
-	std::function<payload(const ray& ray, payload& payload, const triangle<VB>& triangle)> closest_hit_shader =
-		nullptr;
-	std::function<payload(const ray& ray, payload& payload, const triangle<VB>& triangle)> any_hit_shader =
-		nullptr;
+	MS miss_shader;
+	CHS closest_hit_shader;
+	AHS any_hit_shader;
 
 
 protected:
 	std::shared_ptr<cg::resource<RT>> render_target;
 	std::vector<std::shared_ptr<cg::resource<VB>>> per_shape_vertex_buffer;
+	std::shared_ptr<std::vector<cg::material>> materials;
 
 	float get_random(const int thread_num, float range = 0.1f) const;
 
@@ -140,61 +150,68 @@ protected:
 	size_t height = 1080;
 };
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::set_render_target(std::shared_ptr<resource<RT>> in_render_target)
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::set_render_target(std::shared_ptr<resource<RT>> in_render_target)
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::clear_render_target(const RT& in_clear_value)
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::clear_render_target(const RT& in_clear_value)
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::set_per_shape_vertex_buffer(
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::set_per_shape_vertex_buffer(
 	std::vector<std::shared_ptr<cg::resource<VB>>> in_per_shape_vertex_buffer)
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::build_acceleration_structure()
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::set_materials(
+	std::shared_ptr<std::vector<cg::material>> in_materials)
+{
+	materials = in_materials;
+}
+
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::build_acceleration_structure()
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::set_viewport(size_t in_width, size_t in_height)
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::set_viewport(size_t in_width, size_t in_height)
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
-inline void raytracer<VB, RT>::ray_generation(
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline void raytracer<VB, RT, MS, CHS, AHS>::ray_generation(
 	float3 position, float3 direction, float3 right, float3 up)
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
 inline payload
-	raytracer<VB, RT>::trace_ray(const ray& ray, size_t depth, float max_t, float min_t) const
+	raytracer<VB, RT, MS, CHS, AHS>::trace_ray(const ray& ray, size_t depth, float max_t, float min_t) const
 {
 	THROW_ERROR("Not implemented yet");
 }
 
-template<typename VB, typename RT>
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
 inline payload
-	raytracer<VB, RT>::intersection_shader(const triangle<VB>& triangle, const ray& ray) const
+	raytracer<VB, RT, MS, CHS, AHS>::intersection_shader(const triangle<VB>& triangle, const ray& ray) const
 {
 	THROW_ERROR("Not implemented yet");
 	return payload{};
 }
 
-template<typename VB, typename RT>
-inline float raytracer<VB, RT>::get_random(const int thread_num, const float range) const
+template<typename VB, typename RT, typename MS, typename CHS, typename AHS>
+inline float raytracer<VB, RT, MS, CHS, AHS>::get_random(const int thread_num, const float range) const
 {
 	static std::default_random_engine generator(thread_num);
 	static std::normal_distribution<float> distribution(0.f, range);
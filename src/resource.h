@@ -3,46 +3,564 @@
 #include "utils/error_handler.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <linalg.h>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 
 using namespace linalg::aliases;
 
 namespace cg
 {
+// Contiguous elements, e.g. the storage of a resource for SIMD kernels
+template<typename T>
+struct span
+{
+	T* data = nullptr;
+	size_t size = 0;
+
+	T* begin() const { return data; }
+	T* end() const { return data + size; }
+	T& operator[](size_t i) const { return data[i]; }
+};
+
+template<typename T>
+class resource;
+
+// Position of an item in the storage of a tiled resource
+inline size_t get_tiled_index(
+	size_t x, size_t y, unsigned tile_width_bits, unsigned tile_height_bits, size_t tiles_x)
+{
+	const size_t tile_x = x >> tile_width_bits;
+	const size_t tile_y = y >> tile_height_bits;
+	const size_t in_tile_x = x & ((size_t(1) << tile_width_bits) - 1);
+	const size_t in_tile_y = y & ((size_t(1) << tile_height_bits) - 1);
+	return ((tile_y * tiles_x + tile_x) << (tile_width_bits + tile_height_bits)) +
+		   (in_tile_y << tile_width_bits) + in_tile_x;
+}
+
+// Unchecked access to a rectangle of a 2D resource, the accessors are
+// asserted in debug builds. Views don't own the storage, the resource
+// should outlive them.
+template<typename T>
+class resource_view
+{
+public:
+	resource_view() = default;
+
+	T& operator()(size_t x, size_t y) const;
+	// Items of a row are contiguous in linear resources and inside of a
+	// column of tiles in tiled ones
+	span<T> row(size_t y) const;
+	resource_view subview(size_t x, size_t y, size_t in_width, size_t in_height) const;
+	// Visits the items in the order of the memory, f(x, y, item)
+	template<typename F>
+	void for_each(F&& f) const;
+
+	size_t get_width() const;
+	size_t get_height() const;
+
+private:
+	friend class resource<T>;
+
+	T* data = nullptr;
+	size_t origin_x = 0;
+	size_t origin_y = 0;
+	size_t width = 0;
+	size_t height = 0;
+	size_t stride = 0;
+
+	bool tiled = false;
+	unsigned tile_width_bits = 0;
+	unsigned tile_height_bits = 0;
+	size_t tiles_x = 0;
+
+	// Coordinates are in the resource
+	size_t get_index(size_t x, size_t y) const;
+};
+
+template<typename T>
+inline T& resource_view<T>::operator()(size_t x, size_t y) const
+{
+	assert(x < width && y < height);
+	return data[get_index(origin_x + x, origin_y + y)];
+}
+
+template<typename T>
+inline span<T> resource_view<T>::row(size_t y) const
+{
+	assert(y < height);
+	assert(!tiled || width == 0 ||
+		   (origin_x >> tile_width_bits) == ((origin_x + width - 1) >> tile_width_bits));
+	if (width == 0)
+		return span<T>{};
+	return span<T>{ data + get_index(origin_x, origin_y + y), width };
+}
+
+template<typename T>
+inline resource_view<T> resource_view<T>::subview(
+	size_t x, size_t y, size_t in_width, size_t in_height) const
+{
+	assert(x + in_width <= width && y + in_height <= height);
+	resource_view<T> view = *this;
+	view.origin_x += x;
+	view.origin_y += y;
+	view.width = in_width;
+	view.height = in_height;
+	return view;
+}
+
+template<typename T>
+template<typename F>
+inline void resource_view<T>::for_each(F&& f) const
+{
+	const size_t x_end = origin_x + width;
+	const size_t y_end = origin_y + height;
+	if (!tiled)
+	{
+		for (size_t y = origin_y; y < y_end; y++)
+		{
+			T* row_data = data + y * stride;
+			for (size_t x = origin_x; x < x_end; x++)
+				f(x - origin_x, y - origin_y, row_data[x]);
+		}
+		return;
+	}
+
+	// Tile by tile, the rows of a tile are adjacent
+	for (size_t tile_y = origin_y >> tile_height_bits; (tile_y << tile_height_bits) < y_end;
+		 tile_y++)
+	{
+		const size_t tile_y_begin = std::max(tile_y << tile_height_bits, origin_y);
+		const size_t tile_y_end = std::min((tile_y + 1) << tile_height_bits, y_end);
+		for (size_t tile_x = origin_x >> tile_width_bits; (tile_x << tile_width_bits) < x_end;
+			 tile_x++)
+		{
+			const size_t tile_x_begin = std::max(tile_x << tile_width_bits, origin_x);
+			const size_t tile_x_end = std::min((tile_x + 1) << tile_width_bits, x_end);
+			for (size_t y = tile_y_begin; y < tile_y_end; y++)
+			{
+				T* row_data = data + get_index(tile_x_begin, y);
+				for (size_t x = tile_x_begin; x < tile_x_end; x++)
+					f(x - origin_x, y - origin_y, row_data[x - tile_x_begin]);
+			}
+		}
+	}
+}
+
+template<typename T>
+inline size_t resource_view<T>::get_width() const
+{
+	return width;
+}
+
+template<typename T>
+inline size_t resource_view<T>::get_height() const
+{
+	return height;
+}
+
+template<typename T>
+inline size_t resource_view<T>::get_index(size_t x, size_t y) const
+{
+	if (tiled)
+		return get_tiled_index(x, y, tile_width_bits, tile_height_bits, tiles_x);
+	return y * stride + x;
+}
+
+// Bump allocator for the scratch data of a frame or a draw call. Memory is
+// taken from blocks, which are kept when the arena is rewound, so once the
+// blocks have grown to the peak of a frame the arena stops allocating.
+// Deallocation is a no-op. Allocation is thread-safe: it bumps the offset
+// of the current block atomically and takes the lock only to move to the
+// next block. Markers and rewinds shouldn't race with allocations.
+class frame_arena : public std::pmr::memory_resource
+{
+public:
+	struct marker
+	{
+		size_t block = 0;
+		size_t offset = 0;
+	};
+
+	// Memory allocated inside of the scope is released at its end
+	class scope
+	{
+	public:
+		scope(frame_arena& in_arena) : arena(in_arena), begin(in_arena.get_marker()){};
+		~scope() { arena.rewind(begin); }
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+	private:
+		frame_arena& arena;
+		marker begin;
+	};
+
+	static constexpr size_t default_block_size = 1024 * 1024;
+
+	frame_arena(
+		size_t in_block_size = default_block_size,
+		std::pmr::memory_resource* in_upstream = std::pmr::new_delete_resource());
+	~frame_arena() override;
+	frame_arena(const frame_arena&) = delete;
+	frame_arena& operator=(const frame_arena&) = delete;
+
+	marker get_marker() const;
+	void rewind(const marker& in_marker);
+	void reset();
+
+	// Blocks taken from the upstream resource since the arena was created
+	size_t get_upstream_allocations() const;
+	size_t get_capacity() const;
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override{};
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	struct block
+	{
+		std::byte* data;
+		size_t size;
+	};
+
+	static constexpr size_t block_alignment = 64;
+	static constexpr size_t max_blocks = 64;
+	// The current block and the offset in it are packed into one word, so
+	// an allocation is a single compare and swap
+	static constexpr unsigned offset_bits = 56;
+	static constexpr uint64_t offset_mask = (uint64_t(1) << offset_bits) - 1;
+
+	static uint64_t pack(size_t in_block, size_t in_offset);
+	static marker unpack(uint64_t in_position);
+	// Aligned allocation from the block of the position or nullptr
+	void* try_allocate(uint64_t& in_out_position, size_t bytes, size_t alignment);
+
+	std::pmr::memory_resource* upstream;
+	size_t block_size;
+	// Reserved up front, so adding a block allocates only the block
+	std::vector<block> blocks;
+	std::atomic<size_t> num_blocks{ 0 };
+	std::atomic<uint64_t> position{ 0 };
+	// Guards the growth of the blocks
+	size_t upstream_allocations = 0;
+	mutable std::mutex mutex;
+};
+
+inline frame_arena::frame_arena(size_t in_block_size, std::pmr::memory_resource* in_upstream) :
+upstream(in_upstream), block_size(in_block_size)
+{
+	if (in_block_size == 0)
+		THROW_ERROR("Block size of an arena should be positive");
+	blocks.reserve(max_blocks);
+}
+
+inline frame_arena::~frame_arena()
+{
+	for (const block& block : blocks)
+		upstream->deallocate(block.data, block.size, block_alignment);
+}
+
+inline uint64_t frame_arena::pack(size_t in_block, size_t in_offset)
+{
+	return (uint64_t(in_block) << offset_bits) | uint64_t(in_offset);
+}
+
+inline frame_arena::marker frame_arena::unpack(uint64_t in_position)
+{
+	return marker{ static_cast<size_t>(in_position >> offset_bits),
+				   static_cast<size_t>(in_position & offset_mask) };
+}
+
+inline frame_arena::marker frame_arena::get_marker() const
+{
+	return unpack(position.load(std::memory_order_acquire));
+}
+
+inline void frame_arena::rewind(const marker& in_marker)
+{
+	position.store(pack(in_marker.block, in_marker.offset), std::memory_order_release);
+}
+
+inline void frame_arena::reset()
+{
+	rewind(marker{});
+}
+
+inline size_t frame_arena::get_upstream_allocations() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return upstream_allocations;
+}
+
+inline size_t frame_arena::get_capacity() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t capacity = 0;
+	for (const block& block : blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+inline void* frame_arena::try_allocate(
+	uint64_t& in_out_position, size_t bytes, size_t alignment)
+{
+	const marker current = unpack(in_out_position);
+	if (current.block >= num_blocks.load(std::memory_order_acquire))
+		return nullptr;
+
+	const block& block = blocks[current.block];
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(block.data);
+	for (;;)
+	{
+		const size_t offset =
+			((begin + unpack(in_out_position).offset + alignment - 1) &
+			 ~(uintptr_t(alignment) - 1)) -
+			begin;
+		if (offset + bytes > block.size)
+			return nullptr;
+		// A failed swap reloads the position, which may be in another block
+		if (position.compare_exchange_weak(
+				in_out_position, pack(current.block, offset + bytes), std::memory_order_acq_rel))
+			return block.data + offset;
+		if (unpack(in_out_position).block != current.block)
+			return nullptr;
+	}
+}
+
+inline void* frame_arena::do_allocate(size_t bytes, size_t alignment)
+{
+	uint64_t current = position.load(std::memory_order_acquire);
+	if (void* pointer = try_allocate(current, bytes, alignment))
+		return pointer;
+
+	// Only the threads which move to the next block are serialized
+	std::lock_guard<std::mutex> lock(mutex);
+	for (;;)
+	{
+		current = position.load(std::memory_order_acquire);
+		if (void* pointer = try_allocate(current, bytes, alignment))
+			return pointer;
+
+		// The tail of a block which is too small is skipped
+		const size_t next_block = num_blocks.load() == 0 ? 0 : unpack(current).block + 1;
+		if (next_block == blocks.size())
+		{
+			// Blocks grow geometrically, so a frame needs a few of them
+			if (blocks.size() == max_blocks)
+				THROW_ERROR("Arena is out of blocks");
+			size_t size = blocks.empty() ? block_size : blocks.back().size * 2;
+			size = std::max(size, bytes + alignment);
+			blocks.push_back(block{
+				static_cast<std::byte*>(upstream->allocate(size, block_alignment)), size });
+			num_blocks.store(blocks.size(), std::memory_order_release);
+			upstream_allocations++;
+		}
+		// Other threads may still bump the offset of the current block
+		position.compare_exchange_strong(
+			current, pack(next_block, 0), std::memory_order_acq_rel);
+	}
+}
+
+inline bool frame_arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+// How the storage of a resource is allocated. The storage is aligned to a
+// cache line.
+struct allocation_policy
+{
+	// Elements are default-initialized, so trivial types are left
+	// uninitialized. For resources which are cleared or written before they
+	// are read.
+	bool uninitialized = false;
+	// Large allocations are aligned to huge pages and advised to be backed by
+	// transparent huge pages, where the system supports it
+	bool huge_pages = false;
+	// Storage is taken from the arena instead of the heap, the arena should
+	// outlive the resource
+	std::pmr::memory_resource* arena = nullptr;
+
+	bool operator==(const allocation_policy& other) const
+	{
+		return uninitialized == other.uninitialized && huge_pages == other.huge_pages &&
+			   arena == other.arena;
+	}
+	bool operator!=(const allocation_policy& other) const { return !(*this == other); }
+};
+
+template<typename T>
+class resource_allocator
+{
+public:
+	using value_type = T;
+
+	static constexpr size_t alignment = 64;
+	static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+	resource_allocator() = default;
+	resource_allocator(const allocation_policy& in_policy) : policy(in_policy){};
+	template<typename U>
+	resource_allocator(const resource_allocator<U>& other) : policy(other.get_policy()){};
+
+	T* allocate(size_t n)
+	{
+		const size_t size = n * sizeof(T);
+		if (policy.arena)
+			return static_cast<T*>(policy.arena->allocate(size, alignment));
+
+		void* pointer = ::operator new(size, std::align_val_t{ get_alignment(size) });
+#ifdef __linux__
+		if (get_alignment(size) == huge_page_size)
+			madvise(pointer, size, MADV_HUGEPAGE);
+#endif
+		return static_cast<T*>(pointer);
+	}
+
+	void deallocate(T* pointer, size_t n)
+	{
+		const size_t size = n * sizeof(T);
+		if (policy.arena)
+			policy.arena->deallocate(pointer, size, alignment);
+		else
+			::operator delete(pointer, std::align_val_t{ get_alignment(size) });
+	}
+
+	// Value-initialization zeroes the elements, default-initialization
+	// leaves trivial ones as they are
+	template<typename U, typename... Args>
+	void construct(U* pointer, Args&&... args)
+	{
+		if constexpr (sizeof...(Args) == 0)
+		{
+			if (policy.uninitialized)
+			{
+				::new (static_cast<void*>(pointer)) U;
+				return;
+			}
+		}
+		::new (static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+	}
+
+	const allocation_policy& get_policy() const { return policy; }
+
+	template<typename U>
+	bool operator==(const resource_allocator<U>& other) const
+	{
+		return policy == other.get_policy();
+	}
+	template<typename U>
+	bool operator!=(const resource_allocator<U>& other) const
+	{
+		return policy != other.get_policy();
+	}
+
+private:
+	allocation_policy policy;
+
+	size_t get_alignment(size_t size) const
+	{
+		return policy.huge_pages && size >= huge_page_size ? huge_page_size : alignment;
+	}
+};
+
 template<typename T>
 class resource
 {
 public:
-	resource(size_t size);
-	resource(size_t x_size, size_t y_size);
+	resource(size_t size, const allocation_policy& in_policy = {});
+	resource(size_t x_size, size_t y_size, const allocation_policy& in_policy = {});
+	// Tiles of tile_width x tile_height elements are stored one after
+	// another, rows of a tile are adjacent. Tile sizes are powers of two, the
+	// tiles on the right and bottom borders are padded.
+	resource(
+		size_t x_size, size_t y_size, size_t tile_width, size_t tile_height,
+		const allocation_policy& in_policy = {});
 	~resource();
 
 	const T* get_data();
+	// The whole storage in the order of the memory, including the padding
+	// of the tiles
+	span<T> get_span();
+	// 1D resources are viewed as a row
+	resource_view<T> get_view();
+	// Linear items of a tiled resource are in the row-major order
 	T& item(size_t item);
 	T& item(size_t x, size_t y);
 
+	// Size of the storage, including the padding of the tiles
 	size_t get_size_in_bytes() const;
 	size_t get_number_of_elements() const;
 	size_t get_stride() const;
 
+	bool is_tiled() const;
+	size_t get_tile_width() const;
+	size_t get_tile_height() const;
+
 private:
-	std::vector<T> data;
+	std::vector<T, resource_allocator<T>> data;
 	size_t item_size = sizeof(T);
 	size_t stride;
+	size_t number_of_elements;
+
+	bool tiled = false;
+	unsigned tile_width_bits = 0;
+	unsigned tile_height_bits = 0;
+	size_t tiles_x = 0;
 };
 template<typename T>
-inline resource<T>::resource(size_t size)
+inline resource<T>::resource(size_t size, const allocation_policy& in_policy) :
+data(resource_allocator<T>(in_policy))
 {
 	data.resize(size);
 	stride = 0;
+	number_of_elements = size;
 }
 template<typename T>
-inline resource<T>::resource(size_t x_size, size_t y_size)
+inline resource<T>::resource(size_t x_size, size_t y_size, const allocation_policy& in_policy) :
+data(resource_allocator<T>(in_policy))
 {
 	data.resize(x_size * y_size);
 	stride = x_size;
+	number_of_elements = x_size * y_size;
+}
+template<typename T>
+inline resource<T>::resource(
+	size_t x_size, size_t y_size, size_t tile_width, size_t tile_height,
+	const allocation_policy& in_policy) :
+data(resource_allocator<T>(in_policy))
+{
+	if (tile_width == 0 || tile_height == 0 || (tile_width & (tile_width - 1)) != 0 ||
+		(tile_height & (tile_height - 1)) != 0)
+		THROW_ERROR("Tile sizes should be powers of two");
+
+	while ((size_t(1) << tile_width_bits) < tile_width)
+		tile_width_bits++;
+	while ((size_t(1) << tile_height_bits) < tile_height)
+		tile_height_bits++;
+
+	tiled = true;
+	tiles_x = (x_size + tile_width - 1) / tile_width;
+	size_t tiles_y = (y_size + tile_height - 1) / tile_height;
+	data.resize(tiles_x * tiles_y * tile_width * tile_height);
+	stride = x_size;
+	number_of_elements = x_size * y_size;
 }
 template<typename T>
 inline resource<T>::~resource()
@@ -55,13 +573,41 @@ inline const T* resource<T>::get_data()
 	return data.data();
 }
 template<typename T>
+inline span<T> resource<T>::get_span()
+{
+	return span<T>{ data.data(), data.size() };
+}
+template<typename T>
+inline resource_view<T> resource<T>::get_view()
+{
+	resource_view<T> view;
+	view.data = data.data();
+	view.width = stride == 0 ? number_of_elements : stride;
+	view.height = stride == 0 ? 1 : number_of_elements / stride;
+	view.stride = view.width;
+	view.tiled = tiled;
+	view.tile_width_bits = tile_width_bits;
+	view.tile_height_bits = tile_height_bits;
+	view.tiles_x = tiles_x;
+	return view;
+}
+template<typename T>
 inline T& resource<T>::item(size_t item)
 {
+	if (tiled)
+		return this->item(item % stride, item / stride);
 	return data.at(item);
 }
 template<typename T>
 inline T& resource<T>::item(size_t x, size_t y)
 {
+	if (tiled)
+	{
+		// Padding of the tiles is inside of the storage but not of the image
+		if (x >= stride || y >= number_of_elements / stride)
+			THROW_ERROR("Item is out of the resource");
+		return data.at(get_tiled_index(x, y, tile_width_bits, tile_height_bits, tiles_x));
+	}
 	return data.at(y * stride + x);
 }
 template<typename T>
@@ -72,7 +618,7 @@ inline size_t resource<T>::get_size_in_bytes() const
 template<typename T>
 inline size_t resource<T>::get_number_of_elements() const
 {
-	return data.size();
+	return number_of_elements;
 }
 
 template<typename T>
@@ -80,6 +626,24 @@ inline size_t resource<T>::get_stride() const
 {
 	return this->stride;
 }
+
+template<typename T>
+inline bool resource<T>::is_tiled() const
+{
+	return tiled;
+}
+
+template<typename T>
+inline size_t resource<T>::get_tile_width() const
+{
+	return tiled ? size_t(1) << tile_width_bits : stride;
+}
+
+template<typename T>
+inline size_t resource<T>::get_tile_height() const
+{
+	return tiled ? size_t(1) << tile_height_bits : 1;
+}
 struct color
 {
 	static color from_float3(const float3& in)
@@ -134,34 +698,235 @@ struct vertex
 	float emissive_r;
 	float emissive_g;
 	float emissive_b;
+};
 
-	inline static vertex vertex::interpolate_bary(
-		const vertex& v1, const vertex& v2, const vertex& v3, float u, float v, float w)
-	{
-		vertex result;
+struct material
+{
+	float3 ambient;
+	float3 diffuse;
+	float3 emissive;
+};
+
+// Normal is encoded with octahedral coordinates, material colors are in a
+// table shared by all vertices: 20 bytes instead of 60 bytes of vertex
+struct compact_vertex
+{
+	float x;
+	float y;
+	float z;
+
+	// Signed normalized, see encode_octahedral
+	int16_t normal_u;
+	int16_t normal_v;
+
+	uint16_t material_id;
+};
+
+// Octahedral coordinates of a unit vector as signed normalized integers
+struct octahedral_normal
+{
+	int16_t u;
+	int16_t v;
+};
+
+inline int16_t to_snorm16(float in)
+{
+	return static_cast<int16_t>(std::round(std::clamp(in, -1.f, 1.f) * 32767.f));
+}
 
-		result.x = v1.x * u + v2.x * v + v3.x * w;
-		result.y = v1.y * u + v2.y * v + v3.y * w;
-		result.z = v1.z * u + v2.z * v + v3.z * w;
+inline float from_snorm16(int16_t in)
+{
+	return std::max(static_cast<float>(in) / 32767.f, -1.f);
+}
 
-		result.nx = v1.nx * u + v2.nx * v + v3.nx * w;
-		result.ny = v1.ny * u + v2.ny * v + v3.ny * w;
-		result.nz = v1.nz * u + v2.nz * v + v3.nz * w;
+// Unit vectors are projected onto the octahedron |x| + |y| + |z| = 1, whose
+// lower half is folded over the upper one, so they map onto [-1, 1] x [-1, 1].
+// The coordinates are quantized to 16 bits each.
+inline octahedral_normal encode_octahedral(const float3& in)
+{
+	float sum = std::abs(in.x) + std::abs(in.y) + std::abs(in.z);
+	if (sum == 0.f)
+		return octahedral_normal{ 0, 0 };
 
-		result.ambient_r = v1.ambient_r * u + v2.ambient_r * v + v3.ambient_r * w;
-		result.ambient_g = v1.ambient_g * u + v2.ambient_g * v + v3.ambient_g * w;
-		result.ambient_b = v1.ambient_b * u + v2.ambient_b * v + v3.ambient_b * w;
+	float2 result{ in.x / sum, in.y / sum };
+	if (in.z < 0.f)
+	{
+		result = float2{ (1.f - std::abs(result.y)) * (result.x >= 0.f ? 1.f : -1.f),
+						 (1.f - std::abs(result.x)) * (result.y >= 0.f ? 1.f : -1.f) };
+	}
+	return octahedral_normal{ to_snorm16(result.x), to_snorm16(result.y) };
+}
 
-		result.diffuse_r = v1.diffuse_r * u + v2.diffuse_r * v + v3.diffuse_r * w;
-		result.diffuse_g = v1.diffuse_g * u + v2.diffuse_g * v + v3.diffuse_g * w;
-		result.diffuse_b = v1.diffuse_b * u + v2.diffuse_b * v + v3.diffuse_b * w;
+inline float3 decode_octahedral(const octahedral_normal& in_normal)
+{
+	float2 in{ from_snorm16(in_normal.u), from_snorm16(in_normal.v) };
+	float3 result{ in.x, in.y, 1.f - std::abs(in.x) - std::abs(in.y) };
+	if (result.z < 0.f)
+	{
+		result.x = (1.f - std::abs(in.y)) * (in.x >= 0.f ? 1.f : -1.f);
+		result.y = (1.f - std::abs(in.x)) * (in.y >= 0.f ? 1.f : -1.f);
+	}
+	return normalize(result);
+}
+
+// Attributes of a vertex type as member pointers, e.g.
+// using normal = attribute_list<&vertex::nx, &vertex::ny, &vertex::nz>;
+template<auto... Members>
+struct attribute_list
+{
+	static constexpr size_t size = sizeof...(Members);
 
-		result.emissive_r = v1.emissive_r * u + v2.emissive_r * v + v3.emissive_r * w;
-		result.emissive_g = v1.emissive_g * u + v2.emissive_g * v + v3.emissive_g * w;
-		result.emissive_b = v1.emissive_b * u + v2.emissive_b * v + v3.emissive_b * w;
+	template<typename F>
+	static constexpr void for_each(F&& f)
+	{
+		(f(Members), ...);
+	}
 
+	template<typename M>
+	static constexpr bool contains(M in_member)
+	{
+		bool result = false;
+		for_each([&](auto member) {
+			if constexpr (std::is_same_v<decltype(member), M>)
+				result |= member == in_member;
+		});
 		return result;
 	}
+
+	// Reads float attributes into a vector, e.g. float3
+	template<typename V, typename VB>
+	static V load(const VB& vertex)
+	{
+		return V{ vertex.*Members... };
+	}
+};
+
+template<typename... Lists>
+struct attribute_list_cat;
+
+template<auto... Members>
+struct attribute_list_cat<attribute_list<Members...>>
+{
+	using type = attribute_list<Members...>;
 };
 
+template<auto... First, auto... Second, typename... Rest>
+struct attribute_list_cat<attribute_list<First...>, attribute_list<Second...>, Rest...>
+	: attribute_list_cat<attribute_list<First..., Second...>, Rest...>
+{
+};
+
+template<typename... Lists>
+using attribute_list_cat_t = typename attribute_list_cat<Lists...>::type;
+
+// Every vertex type describes its attributes, so the interpolation code is
+// generated for it. Float attributes are interpolated, the rest are taken
+// from the first vertex. A layout with set_normal stores the normal
+// encoded, which isn't linear, so the normal is interpolated decoded.
+template<typename VB>
+struct vertex_layout;
+
+template<typename VB, typename = void>
+struct has_encoded_normal : std::false_type
+{
+};
+
+template<typename VB>
+struct has_encoded_normal<VB, std::void_t<decltype(&vertex_layout<VB>::set_normal)>>
+	: std::true_type
+{
+};
+
+template<typename VB>
+constexpr bool has_encoded_normal_v = has_encoded_normal<VB>::value;
+
+// Interpolated vertex as a pixel shader receives it. An encoded normal is
+// passed as the interpolated float3, it isn't encoded again per pixel.
+template<typename VB>
+struct decoded_vertex : VB
+{
+	float3 normal;
+};
+
+template<typename VB>
+using decoded_vertex_t = std::conditional_t<has_encoded_normal_v<VB>, decoded_vertex<VB>, VB>;
+
+template<>
+struct vertex_layout<vertex>
+{
+	using position = attribute_list<&vertex::x, &vertex::y, &vertex::z>;
+	using normal = attribute_list<&vertex::nx, &vertex::ny, &vertex::nz>;
+	using ambient = attribute_list<&vertex::ambient_r, &vertex::ambient_g, &vertex::ambient_b>;
+	using diffuse = attribute_list<&vertex::diffuse_r, &vertex::diffuse_g, &vertex::diffuse_b>;
+	using emissive =
+		attribute_list<&vertex::emissive_r, &vertex::emissive_g, &vertex::emissive_b>;
+	using attributes = attribute_list_cat_t<position, normal, ambient, diffuse, emissive>;
+
+	static float3 get_normal(const vertex& in_vertex)
+	{
+		return normal::load<float3>(in_vertex);
+	}
+
+	// cg::vertex carries its colors inline, so the material table isn't used
+	static material get_material(const vertex& in_vertex, const material*)
+	{
+		return material{ ambient::load<float3>(in_vertex), diffuse::load<float3>(in_vertex),
+						 emissive::load<float3>(in_vertex) };
+	}
+};
+
+template<>
+struct vertex_layout<compact_vertex>
+{
+	using position =
+		attribute_list<&compact_vertex::x, &compact_vertex::y, &compact_vertex::z>;
+	using normal = attribute_list<&compact_vertex::normal_u, &compact_vertex::normal_v>;
+	using attributes =
+		attribute_list_cat_t<position, normal, attribute_list<&compact_vertex::material_id>>;
+
+	static float3 get_normal(const compact_vertex& in_vertex)
+	{
+		return decode_octahedral(octahedral_normal{ in_vertex.normal_u, in_vertex.normal_v });
+	}
+
+	// Interpolated normal of a pixel, not normalized like the one of cg::vertex
+	static float3 get_normal(const decoded_vertex<compact_vertex>& in_vertex)
+	{
+		return in_vertex.normal;
+	}
+
+	static void set_normal(compact_vertex& out_vertex, const float3& in_normal)
+	{
+		octahedral_normal encoded = encode_octahedral(in_normal);
+		out_vertex.normal_u = encoded.u;
+		out_vertex.normal_v = encoded.v;
+	}
+
+	static material get_material(const compact_vertex& in_vertex, const material* in_materials)
+	{
+		if (!in_materials)
+			THROW_ERROR("Compact vertices require a material table");
+		return in_materials[in_vertex.material_id];
+	}
+};
+
+template<typename VB>
+inline VB interpolate_bary(
+	const VB& v1, const VB& v2, const VB& v3, float u, float v, float w)
+{
+	using layout = vertex_layout<VB>;
+	VB result = v1;
+	layout::attributes::for_each([&](auto member) {
+		if constexpr (std::is_same_v<decltype(member), float VB::*>)
+			result.*member = v1.*member * u + v2.*member * v + v3.*member * w;
+	});
+	if constexpr (has_encoded_normal_v<VB>)
+	{
+		layout::set_normal(
+			result, layout::get_normal(v1) * u + layout::get_normal(v2) * v +
+						layout::get_normal(v3) * w);
+	}
+	return result;
+}
+
 } // namespace cg
\ No newline at end of file
@@ -41,6 +41,46 @@ std::shared_ptr<settings> cg::settings::parse_settings(int argc, char** argv)
 		"accumulation_num", "Number of accumulated frames",
 		cxxopts::value<unsigned>()->default_value("4"));
 	add_options("smooth_shading", "Smooth shading", cxxopts::value<bool>()->default_value("true"));
+	add_options(
+		"parallel_vertex_processing", "Process vertices and set up triangles in parallel",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"tiled_rasterization", "Rasterize screen tiles in parallel",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options("tile_size", "Size of a rasterization tile", cxxopts::value<unsigned>()->default_value("64"));
+	add_options(
+		"depth_prepass", "Draw depth before shading to avoid overdraw",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"visibility_buffer", "Rasterize primitive ids, then shade every pixel once",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"sample_count", "Samples per pixel for multisampling: 1, 2, 4 or 8",
+		cxxopts::value<unsigned>()->default_value("1"));
+	add_options(
+		"fast_clear", "Clear render target tiles when they are first drawn to",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"triangle_strips", "Convert the model to triangle strips after loading",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"occlusion_queries", "Skip shapes whose bounding boxes are hidden by the shapes in front",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"tiled_targets", "Store render targets in 8x8 pixel tiles, as they are rasterized",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"exposure", "Scale of the linear colors before tone mapping",
+		cxxopts::value<float>()->default_value("1.0"));
+	add_options(
+		"tone_mapping", "Tone curve of the resolve: none, reinhard or aces",
+		cxxopts::value<std::string>()->default_value("none"));
+	add_options(
+		"srgb", "Encode the tone mapped colors with the sRGB transfer function",
+		cxxopts::value<bool>()->default_value("false"));
+	add_options(
+		"statistics", "Print the statistics of the last frame at exit",
+		cxxopts::value<bool>()->default_value("false"));
 	add_options("h,help", "Print usage");
 
 	auto result = options.parse(argc, argv);
@@ -62,6 +102,20 @@ std::shared_ptr<settings> cg::settings::parse_settings(int argc, char** argv)
 	settings->result_path = result["result_path"].as<std::filesystem::path>();
 	settings->accumulation_num = result["accumulation_num"].as<unsigned>();
 	settings->smooth_shading = result["smooth_shading"].as<bool>();
+	settings->parallel_vertex_processing = result["parallel_vertex_processing"].as<bool>();
+	settings->tiled_rasterization = result["tiled_rasterization"].as<bool>();
+	settings->tile_size = result["tile_size"].as<unsigned>();
+	settings->depth_prepass = result["depth_prepass"].as<bool>();
+	settings->visibility_buffer = result["visibility_buffer"].as<bool>();
+	settings->sample_count = result["sample_count"].as<unsigned>();
+	settings->fast_clear = result["fast_clear"].as<bool>();
+	settings->triangle_strips = result["triangle_strips"].as<bool>();
+	settings->occlusion_queries = result["occlusion_queries"].as<bool>();
+	settings->tiled_targets = result["tiled_targets"].as<bool>();
+	settings->exposure = result["exposure"].as<float>();
+	settings->tone_mapping = result["tone_mapping"].as<std::string>();
+	settings->srgb = result["srgb"].as<bool>();
+	settings->statistics = result["statistics"].as<bool>();
 
 	return settings;
 }
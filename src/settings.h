@@ -24,6 +24,20 @@ struct settings
 	float camera_z_near;
 	float camera_z_far;
 	bool smooth_shading = true;
+	bool parallel_vertex_processing = false;
+	bool tiled_rasterization = false;
+	unsigned tile_size = 64;
+	bool depth_prepass = false;
+	bool visibility_buffer = false;
+	unsigned sample_count = 1;
+	bool fast_clear = false;
+	bool triangle_strips = false;
+	bool occlusion_queries = false;
+	bool tiled_targets = false;
+	float exposure = 1.f;
+	std::string tone_mapping;
+	bool srgb = false;
+	bool statistics = false;
 
 	std::string renderer_type;
 
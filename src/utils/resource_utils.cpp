@@ -10,15 +10,31 @@
 
 using namespace cg::utils;
 
-void cg::utils::save_resource(
-	cg::resource<cg::unsigned_color>& render_target, std::filesystem::path filepath)
+namespace
+{
+void write_png(
+	cg::resource<cg::unsigned_color>& render_target, const std::filesystem::path& filepath,
+	std::pmr::memory_resource* memory)
 {
 	int width = static_cast<int>(render_target.get_stride());
 	int height = static_cast<int>(render_target.get_number_of_elements()) / width;
 
+	// Tiled targets are linearized only for the export
+	const cg::unsigned_color* data = render_target.get_data();
+	std::pmr::vector<cg::unsigned_color> rows(memory);
+	if (render_target.is_tiled())
+	{
+		// Tiles are read in the order of the memory
+		rows.resize(render_target.get_number_of_elements());
+		render_target.get_view().for_each(
+			[&](size_t x, size_t y, const cg::unsigned_color& color) {
+				rows[y * width + x] = color;
+			});
+		data = rows.data();
+	}
+
 	int result = stbi_write_png(
-		filepath.string().c_str(), width, height, 3, render_target.get_data(),
-		width * sizeof(cg::unsigned_color));
+		filepath.string().c_str(), width, height, 3, data, width * sizeof(cg::unsigned_color));
 
 	if (result != 1)
 		THROW_ERROR("Can't save the resource");
@@ -28,3 +44,18 @@ void cg::utils::save_resource(
 
 	std::system(view_command.c_str());
 }
+} // namespace
+
+void cg::utils::save_resource(
+	cg::resource<cg::unsigned_color>& render_target, std::filesystem::path filepath)
+{
+	write_png(render_target, filepath, std::pmr::get_default_resource());
+}
+
+void cg::utils::save_resource(
+	cg::resource<cg::unsigned_color>& render_target, std::filesystem::path filepath,
+	cg::frame_arena& arena)
+{
+	cg::frame_arena::scope scratch(arena);
+	write_png(render_target, filepath, &arena);
+}
@@ -8,4 +8,8 @@
 namespace cg::utils
 {
 void save_resource(cg::resource<cg::unsigned_color>& render_target, std::filesystem::path filepath);
+// Tiled targets are linearized in the scratch memory of the arena
+void save_resource(
+	cg::resource<cg::unsigned_color>& render_target, std::filesystem::path filepath,
+	cg::frame_arena& arena);
 }
\ No newline at end of file
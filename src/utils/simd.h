@@ -0,0 +1,10 @@
+#pragma once
+
+// SSE2 is a part of x64, so the scalar kernels are used only on other
+// targets or when CG_RASTERIZER_SCALAR is defined, e.g. by the Scalar
+// configuration
+#if !defined(CG_RASTERIZER_SCALAR) && \
+	(defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CG_RASTERIZER_SSE
+#include <emmintrin.h>
+#endif
@@ -4,16 +4,161 @@
 
 #include "utils/error_handler.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
 #include <linalg.h>
+#include <memory_resource>
+#include <unordered_map>
 
 
 using namespace linalg::aliases;
 using namespace cg::world;
 
+namespace
+{
+// Vertices are equal only if they are equal bitwise
+struct vertex_hash
+{
+	size_t operator()(const cg::vertex& vertex) const
+	{
+		// FNV-1a
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+		size_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < sizeof(cg::vertex); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
+struct vertex_equal
+{
+	bool operator()(const cg::vertex& a, const cg::vertex& b) const
+	{
+		return std::memcmp(&a, &b, sizeof(cg::vertex)) == 0;
+	}
+};
+
+// Greedy stripification: a strip grows while an unused triangle has the
+// last edge of the strip with the winding the next strip position expects.
+// Strips are joined with degenerate triangles, so every strip starts at an
+// even position and keeps its winding.
+std::pmr::vector<uint32_t> build_strips(
+	const std::pmr::vector<uint32_t>& indices, std::pmr::memory_resource* scratch)
+{
+	const size_t num_triangles = indices.size() / 3;
+	auto edge_key = [](uint32_t a, uint32_t b) {
+		return (static_cast<uint64_t>(a) << 32) | b;
+	};
+
+	// Triangles by their directed edges
+	std::pmr::unordered_multimap<uint64_t, size_t> edge_triangles(scratch);
+	for (size_t t = 0; t < num_triangles; t++)
+	{
+		for (size_t i = 0; i < 3; i++)
+			edge_triangles.emplace(edge_key(indices[3 * t + i], indices[3 * t + (i + 1) % 3]), t);
+	}
+
+	std::pmr::vector<unsigned char> used(num_triangles, 0, scratch);
+	auto take_triangle = [&](uint32_t a, uint32_t b, uint32_t& out_third, size_t& out_triangle) {
+		auto range = edge_triangles.equal_range(edge_key(a, b));
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			size_t t = it->second;
+			if (used[t])
+				continue;
+			for (size_t i = 0; i < 3; i++)
+			{
+				if (indices[3 * t + i] == a && indices[3 * t + (i + 1) % 3] == b)
+					out_third = indices[3 * t + (i + 2) % 3];
+			}
+			used[t] = 1;
+			out_triangle = t;
+			return true;
+		}
+		return false;
+	};
+
+	// Grows a strip from a seed triangle, the taken triangles are returned
+	// to undo a trial
+	auto grow_strip = [&](std::pmr::vector<uint32_t>& in_out_strip,
+						  std::pmr::vector<size_t>& out_taken) {
+		for (;;)
+		{
+			// The next triangle is (n - 2, n - 1, x) at an even position and
+			// (n - 1, n - 2, x) at an odd one
+			size_t n = in_out_strip.size();
+			bool odd = (n - 2) % 2 == 1;
+			uint32_t third;
+			size_t taken;
+			if (!take_triangle(
+					in_out_strip[odd ? n - 1 : n - 2], in_out_strip[odd ? n - 2 : n - 1], third,
+					taken))
+				break;
+			in_out_strip.push_back(third);
+			out_taken.push_back(taken);
+		}
+	};
+
+	std::pmr::vector<uint32_t> strips(scratch);
+	std::pmr::vector<uint32_t> strip(scratch);
+	std::pmr::vector<uint32_t> trial(scratch);
+	std::pmr::vector<size_t> taken(scratch);
+	std::pmr::vector<size_t> strip_taken(scratch);
+	for (size_t t = 0; t < num_triangles; t++)
+	{
+		if (used[t])
+			continue;
+		used[t] = 1;
+
+		// Every rotation of the seed starts a different strip, the longest
+		// one is kept
+		strip.clear();
+		strip_taken.clear();
+		for (size_t rotation = 0; rotation < 3; rotation++)
+		{
+			trial.clear();
+			for (size_t i = 0; i < 3; i++)
+				trial.push_back(indices[3 * t + (rotation + i) % 3]);
+
+			taken.clear();
+			grow_strip(trial, taken);
+			for (size_t taken_id : taken)
+				used[taken_id] = 0;
+			if (trial.size() > strip.size())
+			{
+				strip.swap(trial);
+				strip_taken.swap(taken);
+			}
+		}
+		for (size_t taken_id : strip_taken)
+			used[taken_id] = 1;
+
+		if (!strips.empty())
+		{
+			strips.push_back(strips.back());
+			strips.push_back(strip.front());
+			if (strips.size() % 2 == 1)
+				strips.push_back(strip.front());
+		}
+		strips.insert(strips.end(), strip.begin(), strip.end());
+	}
+	return strips;
+}
+} // namespace
+
 cg::world::model::model() {}
 
 cg::world::model::~model() {}
 
+void cg::world::model::set_arena(std::shared_ptr<cg::frame_arena> in_arena)
+{
+	arena = in_arena;
+}
+
 void cg::world::model::load_obj(const std::filesystem::path& model_path)
 {
 	tinyobj::ObjReaderConfig reader_config;
@@ -34,36 +179,40 @@ void cg::world::model::load_obj(const std::filesystem::path& model_path)
 	shapes = reader.GetShapes();
 	materials = reader.GetMaterials();
 
+	build_material_table();
+
+	// Vertices of cg::vertex are released once the compact ones are built
+	std::vector<uint16_t> material_ids;
+	auto face_vertices = build_face_vertices(&material_ids);
+	auto unique_vertices = build_index_buffer(*face_vertices, material_ids);
+	build_compact_vertex_buffer(*unique_vertices, material_ids);
+	build_shape_bounds(*face_vertices);
+
+	vertex_buffer = nullptr;
+	per_shape_buffer.clear();
+	indexed_vertex_buffer = nullptr;
+}
+
+std::shared_ptr<cg::resource<cg::vertex>> cg::world::model::build_face_vertices(
+	std::vector<uint16_t>* out_material_ids) const
+{
 	// Loop over shapes
 	size_t vertex_buffer_id = 0;
-	std::vector<size_t> per_shape_ids(shapes.size());
-
 	for (size_t s = 0; s < shapes.size(); s++)
 	{
-		per_shape_ids[s] = 0;
 		// Loop over faces(polygon)
 		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
-		{
-			int fv = shapes[s].mesh.num_face_vertices[f];
-			vertex_buffer_id += fv;
-			per_shape_ids[s] += fv;
-		}
+			vertex_buffer_id += shapes[s].mesh.num_face_vertices[f];
 	}
 
-	vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(vertex_buffer_id);
-	per_shape_buffer.resize(shapes.size());
-
-	for (size_t s = 0; s < shapes.size(); s++)
-	{
-		per_shape_buffer[s] =
-			std::make_shared<cg::resource<cg::vertex>>(per_shape_ids[s]);
-	}
+	auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(vertex_buffer_id);
+	if (out_material_ids)
+		out_material_ids->resize(vertex_buffer_id);
 
 	// Loop over shapes
 	vertex_buffer_id = 0;
 	for (size_t s = 0; s < shapes.size(); s++)
 	{
-		size_t per_shape_id = 0;
 		// Loop over faces(polygon)
 		size_t index_offset = 0;
 		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
@@ -135,8 +284,13 @@ void cg::world::model::load_obj(const std::filesystem::path& model_path)
 					vertex.emissive_b = material.emission[2];
 				}
 
+				if (out_material_ids)
+				{
+					int material_id = shapes[s].mesh.material_ids[f];
+					(*out_material_ids)[vertex_buffer_id] = static_cast<uint16_t>(
+						material_id >= 0 ? material_id : material_table->size() - 1);
+				}
 				vertex_buffer->item(vertex_buffer_id++) = vertex;
-				per_shape_buffer[s]->item(per_shape_id++) = vertex;
 
 				
 				//tinyobj::real_t tx = attrib.texcoords[2 * idx.texcoord_index + 0];
@@ -152,19 +306,226 @@ void cg::world::model::load_obj(const std::filesystem::path& model_path)
 			//shapes[s].mesh.material_ids[f];
 		}
 	}
+	return vertex_buffer;
+}
+
+void cg::world::model::build_material_table()
+{
+	if (materials.size() >= UINT16_MAX)
+		THROW_ERROR("Too many materials for compact vertices");
+
+	material_table = std::make_shared<std::vector<cg::material>>();
+	material_table->reserve(materials.size() + 1);
+	for (const auto& material : materials)
+	{
+		material_table->push_back(cg::material{
+			float3{ material.ambient[0], material.ambient[1], material.ambient[2] },
+			float3{ material.diffuse[0], material.diffuse[1], material.diffuse[2] },
+			float3{ material.emission[0], material.emission[1], material.emission[2] } });
+	}
+
+	// Colors of faces without a material are zero
+	material_table->push_back(cg::material{});
+}
+
+std::shared_ptr<cg::resource<cg::vertex>> cg::world::model::build_index_buffer(
+	cg::resource<cg::vertex>& in_vertex_buffer, std::vector<uint16_t>& in_out_material_ids)
+{
+	cg::frame_arena local_arena;
+	cg::frame_arena& scratch_arena = arena ? *arena : local_arena;
+	cg::frame_arena::scope scratch(scratch_arena);
+
+	std::pmr::unordered_map<cg::vertex, uint32_t, vertex_hash, vertex_equal> unique_ids(
+		&scratch_arena);
+	std::pmr::vector<cg::vertex> unique_vertices(&scratch_arena);
+	std::vector<uint16_t> unique_material_ids;
+
+	index_buffer =
+		std::make_shared<cg::resource<uint32_t>>(in_vertex_buffer.get_number_of_elements());
+
+	for (size_t i = 0; i < in_vertex_buffer.get_number_of_elements(); i++)
+	{
+		const cg::vertex& vertex = in_vertex_buffer.item(i);
+		auto result =
+			unique_ids.emplace(vertex, static_cast<uint32_t>(unique_vertices.size()));
+		if (result.second)
+		{
+			unique_vertices.push_back(vertex);
+			unique_material_ids.push_back(in_out_material_ids[i]);
+		}
+
+		index_buffer->item(i) = result.first->second;
+	}
+
+	auto indexed_vertex_buffer =
+		std::make_shared<cg::resource<cg::vertex>>(unique_vertices.size());
+	for (size_t i = 0; i < unique_vertices.size(); i++)
+	{
+		indexed_vertex_buffer->item(i) = unique_vertices[i];
+	}
+	in_out_material_ids.swap(unique_material_ids);
+	return indexed_vertex_buffer;
+}
+
+void cg::world::model::build_compact_vertex_buffer(
+	cg::resource<cg::vertex>& in_indexed_vertex_buffer,
+	const std::vector<uint16_t>& in_material_ids)
+{
+	// Material ids are already per indexed vertex
+	compact_vertex_buffer = std::make_shared<cg::resource<cg::compact_vertex>>(
+		in_indexed_vertex_buffer.get_number_of_elements());
+
+	for (size_t i = 0; i < in_indexed_vertex_buffer.get_number_of_elements(); i++)
+	{
+		const cg::vertex& vertex = in_indexed_vertex_buffer.item(i);
+		cg::octahedral_normal normal =
+			cg::encode_octahedral(float3{ vertex.nx, vertex.ny, vertex.nz });
+
+		cg::compact_vertex& compact_vertex = compact_vertex_buffer->item(i);
+		compact_vertex.x = vertex.x;
+		compact_vertex.y = vertex.y;
+		compact_vertex.z = vertex.z;
+		compact_vertex.normal_u = normal.u;
+		compact_vertex.normal_v = normal.v;
+		compact_vertex.material_id = in_material_ids[i];
+	}
+}
+
+void cg::world::model::build_shape_bounds(cg::resource<cg::vertex>& in_vertex_buffer)
+{
+	// Shapes are stored one after another in the vertex and index buffers
+	per_shape_bounds.resize(shapes.size());
+	size_t index_offset = 0;
+
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		shape_bounds& bounds = per_shape_bounds[s];
+		bounds.index_offset = index_offset;
+		bounds.num_indexes = 0;
+		for (int fv : shapes[s].mesh.num_face_vertices)
+			bounds.num_indexes += fv;
+		index_offset += bounds.num_indexes;
+
+		bounds.aabb_min = float3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		bounds.aabb_max = float3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = bounds.index_offset; i < index_offset; i++)
+		{
+			const cg::vertex& vertex = in_vertex_buffer.item(i);
+			float3 position{ vertex.x, vertex.y, vertex.z };
+			bounds.aabb_min = min(bounds.aabb_min, position);
+			bounds.aabb_max = max(bounds.aabb_max, position);
+		}
+
+		if (bounds.num_indexes == 0)
+		{
+			bounds.aabb_min = float3{ 0.f, 0.f, 0.f };
+			bounds.aabb_max = float3{ 0.f, 0.f, 0.f };
+		}
+
+		// Sphere around the box center, tighter than the half diagonal
+		bounds.sphere_center = (bounds.aabb_min + bounds.aabb_max) * 0.5f;
+		bounds.sphere_radius = 0.f;
+		for (size_t i = bounds.index_offset; i < index_offset; i++)
+		{
+			const cg::vertex& vertex = in_vertex_buffer.item(i);
+			float3 position{ vertex.x, vertex.y, vertex.z };
+			bounds.sphere_radius =
+				std::max(bounds.sphere_radius, length(position - bounds.sphere_center));
+		}
+	}
+}
+
+void cg::world::model::stripify()
+{
+	cg::frame_arena local_arena;
+	cg::frame_arena& scratch_arena = arena ? *arena : local_arena;
+	cg::frame_arena::scope scratch(scratch_arena);
+
+	std::pmr::vector<uint32_t> strip_indices(&scratch_arena);
+	for (shape_bounds& bounds : per_shape_bounds)
+	{
+		std::pmr::vector<uint32_t> shape_indices(bounds.num_indexes, &scratch_arena);
+		for (size_t i = 0; i < bounds.num_indexes; i++)
+			shape_indices[i] = index_buffer->item(bounds.index_offset + i);
+
+		std::pmr::vector<uint32_t> shape_strips = build_strips(shape_indices, &scratch_arena);
+		bounds.strip_index_offset = strip_indices.size();
+		bounds.num_strip_indexes = shape_strips.size();
+		strip_indices.insert(strip_indices.end(), shape_strips.begin(), shape_strips.end());
+	}
+
+	strip_index_buffer = std::make_shared<cg::resource<uint32_t>>(strip_indices.size());
+	for (size_t i = 0; i < strip_indices.size(); i++)
+	{
+		strip_index_buffer->item(i) = strip_indices[i];
+	}
 }
 
 std::shared_ptr<cg::resource<cg::vertex>> cg::world::model::get_vertex_buffer() const
 {
+	if (!vertex_buffer)
+		vertex_buffer = build_face_vertices();
 	return vertex_buffer;
 }
 
 std::vector<std::shared_ptr<cg::resource<cg::vertex>>>
 	cg::world::model::get_per_shape_buffer() const
 {
+	if (per_shape_buffer.size() == per_shape_bounds.size())
+		return per_shape_buffer;
+
+	auto vertices = get_vertex_buffer();
+	per_shape_buffer.resize(per_shape_bounds.size());
+	for (size_t s = 0; s < per_shape_bounds.size(); s++)
+	{
+		const shape_bounds& bounds = per_shape_bounds[s];
+		per_shape_buffer[s] = std::make_shared<cg::resource<cg::vertex>>(bounds.num_indexes);
+		for (size_t i = 0; i < bounds.num_indexes; i++)
+			per_shape_buffer[s]->item(i) = vertices->item(bounds.index_offset + i);
+	}
 	return per_shape_buffer;
 }
 
+std::shared_ptr<cg::resource<cg::vertex>> cg::world::model::get_indexed_vertex_buffer() const
+{
+	if (indexed_vertex_buffer)
+		return indexed_vertex_buffer;
+
+	// Vertices with the same index are equal
+	auto vertices = get_vertex_buffer();
+	indexed_vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(
+		compact_vertex_buffer->get_number_of_elements());
+	for (size_t i = 0; i < vertices->get_number_of_elements(); i++)
+		indexed_vertex_buffer->item(index_buffer->item(i)) = vertices->item(i);
+	return indexed_vertex_buffer;
+}
+
+std::shared_ptr<cg::resource<uint32_t>> cg::world::model::get_index_buffer() const
+{
+	return index_buffer;
+}
+
+std::shared_ptr<cg::resource<cg::compact_vertex>>
+	cg::world::model::get_compact_vertex_buffer() const
+{
+	return compact_vertex_buffer;
+}
+
+std::shared_ptr<std::vector<cg::material>> cg::world::model::get_materials() const
+{
+	return material_table;
+}
+
+std::shared_ptr<cg::resource<uint32_t>> cg::world::model::get_strip_index_buffer() const
+{
+	return strip_index_buffer;
+}
+
+const std::vector<cg::world::model::shape_bounds>& cg::world::model::get_per_shape_bounds() const
+{
+	return per_shape_bounds;
+}
+
 
 const float4x4 cg::world::model::get_world_matrix() const
 {
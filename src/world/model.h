@@ -2,6 +2,7 @@
 
 #include "resource.h"
 
+#include <cstdint>
 #include <filesystem>
 #include <linalg.h>
 #include <tiny_obj_loader.h>
@@ -17,10 +18,48 @@ public:
 	model();
 	virtual ~model();
 
+	// Scratch data of loading and stripification, e.g. the map of unique
+	// vertices, is taken from the arena and released before they return.
+	// Without one, a local arena is used.
+	void set_arena(std::shared_ptr<cg::frame_arena> in_arena);
 	void load_obj(const std::filesystem::path& model_path);
+	// Loading keeps only the compact vertices. Buffers of cg::vertex are
+	// built from the faces on the first call and kept, so renderers which
+	// draw the compact vertices don't hold them.
 	std::shared_ptr<cg::resource<cg::vertex>> get_vertex_buffer() const;
 	std::vector<std::shared_ptr<cg::resource<cg::vertex>>> get_per_shape_buffer() const;
 
+	// Unique vertices which reproduce get_vertex_buffer order through
+	// get_index_buffer
+	std::shared_ptr<cg::resource<cg::vertex>> get_indexed_vertex_buffer() const;
+	std::shared_ptr<cg::resource<uint32_t>> get_index_buffer() const;
+
+	// Compact copy of get_indexed_vertex_buffer, vertices refer to
+	// get_materials. The last material is used by faces without one.
+	std::shared_ptr<cg::resource<cg::compact_vertex>> get_compact_vertex_buffer() const;
+	std::shared_ptr<std::vector<cg::material>> get_materials() const;
+
+	// Optional: builds triangle strips of every shape from get_index_buffer,
+	// joined with degenerate triangles, and fills the strip ranges of
+	// get_per_shape_bounds
+	void stripify();
+	std::shared_ptr<cg::resource<uint32_t>> get_strip_index_buffer() const;
+
+	// Range of a shape in get_index_buffer and its object-space bounds
+	struct shape_bounds
+	{
+		size_t index_offset;
+		size_t num_indexes;
+		// Range in get_strip_index_buffer
+		size_t strip_index_offset = 0;
+		size_t num_strip_indexes = 0;
+		float3 aabb_min;
+		float3 aabb_max;
+		float3 sphere_center;
+		float sphere_radius;
+	};
+	const std::vector<shape_bounds>& get_per_shape_bounds() const;
+
 	const float4x4 get_world_matrix() const;
 
 protected:
@@ -28,7 +67,33 @@ protected:
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 
-	std::shared_ptr<cg::resource<cg::vertex>> vertex_buffer;
-	std::vector<std::shared_ptr<cg::resource<cg::vertex>>> per_shape_buffer;
+	// Built on demand
+	mutable std::shared_ptr<cg::resource<cg::vertex>> vertex_buffer;
+	mutable std::vector<std::shared_ptr<cg::resource<cg::vertex>>> per_shape_buffer;
+	mutable std::shared_ptr<cg::resource<cg::vertex>> indexed_vertex_buffer;
+
+	std::shared_ptr<cg::resource<uint32_t>> index_buffer;
+	std::shared_ptr<cg::resource<uint32_t>> strip_index_buffer;
+
+	std::shared_ptr<cg::resource<cg::compact_vertex>> compact_vertex_buffer;
+	std::shared_ptr<std::vector<cg::material>> material_table;
+
+	std::vector<shape_bounds> per_shape_bounds;
+
+	std::shared_ptr<cg::frame_arena> arena;
+
+	void build_material_table();
+	// Vertices of the faces shape after shape, optionally with the ids of
+	// their materials in the table
+	std::shared_ptr<cg::resource<cg::vertex>> build_face_vertices(
+		std::vector<uint16_t>* out_material_ids = nullptr) const;
+	// Returns the unique vertices, the material ids become theirs
+	std::shared_ptr<cg::resource<cg::vertex>> build_index_buffer(
+		cg::resource<cg::vertex>& in_vertex_buffer,
+		std::vector<uint16_t>& in_out_material_ids);
+	void build_compact_vertex_buffer(
+		cg::resource<cg::vertex>& in_indexed_vertex_buffer,
+		const std::vector<uint16_t>& in_material_ids);
+	void build_shape_bounds(cg::resource<cg::vertex>& in_vertex_buffer);
 };
 } // namespace cg::world
\ No newline at end of file
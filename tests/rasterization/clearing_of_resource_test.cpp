@@ -59,6 +59,177 @@ SCENARIO("2D resource could be created and accessed by items", "[resource]")
 	}
 }
 
+SCENARIO("Tiled 2D resource keeps the items of a tile together", "[resource]")
+{
+	GIVEN("2D resource of 4x2 tiles, which doesn't fill the last tiles")
+	{
+		cg::resource<unsigned> res(10, 5, 4, 2);
+		REQUIRE(res.is_tiled());
+		REQUIRE(res.get_number_of_elements() == 50);
+		REQUIRE(res.get_size_in_bytes() == 3 * 3 * 8 * sizeof(unsigned));
+
+		WHEN("Items are numbered in the row-major order")
+		{
+			for (size_t y = 0; y < 5; y++)
+			{
+				for (size_t x = 0; x < 10; x++)
+					res.item(x, y) = static_cast<unsigned>(y * 10 + x);
+			}
+
+			THEN("Linear items are in the row-major order too")
+			{
+				for (size_t i = 0; i < res.get_number_of_elements(); i++)
+					REQUIRE(res.item(i) == i);
+			}
+
+			THEN("Rows of a tile are adjacent in memory")
+			{
+				const unsigned* data = res.get_data();
+				const unsigned first_tile[8] = { 0, 1, 2, 3, 10, 11, 12, 13 };
+				for (size_t i = 0; i < 8; i++)
+					REQUIRE(data[i] == first_tile[i]);
+				REQUIRE(&res.item(4, 0) == &res.item(0, 0) + 8);
+				REQUIRE(&res.item(0, 2) == &res.item(0, 0) + 3 * 8);
+			}
+		}
+
+		THEN("Items in the padding of the last tiles are out of the resource")
+		{
+			REQUIRE_THROWS(res.item(10, 0));
+			REQUIRE_THROWS(res.item(0, 5));
+			REQUIRE_THROWS(res.item(50));
+		}
+	}
+}
+
+SCENARIO("Views access rectangles of resources", "[resource]")
+{
+	GIVEN("Linear and tiled 2D resources with numbered items")
+	{
+		cg::resource<unsigned> linear(12, 10);
+		cg::resource<unsigned> tiled(12, 10, 4, 4);
+		for (auto* res : { &linear, &tiled })
+		{
+			for (size_t y = 0; y < 10; y++)
+			{
+				for (size_t x = 0; x < 12; x++)
+					res->item(x, y) = static_cast<unsigned>(y * 100 + x);
+			}
+		}
+
+		WHEN("Sub-rectangles are viewed")
+		{
+			auto linear_view = linear.get_view().subview(2, 3, 8, 5);
+			auto tiled_view = tiled.get_view().subview(2, 3, 8, 5);
+
+			THEN("Items are relative to the sub-rectangle")
+			{
+				for (size_t y = 0; y < 5; y++)
+				{
+					for (size_t x = 0; x < 8; x++)
+					{
+						REQUIRE(linear_view(x, y) == (y + 3) * 100 + x + 2);
+						REQUIRE(tiled_view(x, y) == (y + 3) * 100 + x + 2);
+					}
+				}
+			}
+
+			THEN("Rows are spans of the items")
+			{
+				cg::span<unsigned> row = linear_view.row(1);
+				REQUIRE(row.size == 8);
+				REQUIRE(row[0] == 402);
+				REQUIRE(row[7] == 409);
+
+				// Inside of a column of tiles
+				cg::span<unsigned> tile_row = tiled.get_view().subview(4, 0, 4, 10).row(6);
+				REQUIRE(tile_row.size == 4);
+				REQUIRE(tile_row[3] == 607);
+			}
+
+			THEN("Every item is visited once, tile by tile in tiled resources")
+			{
+				std::vector<unsigned> visited;
+				tiled_view.for_each([&](size_t x, size_t y, unsigned& item) {
+					REQUIRE(item == (y + 3) * 100 + x + 2);
+					visited.push_back(item);
+				});
+				REQUIRE(visited.size() == 8 * 5);
+				// The first tile ends at x = 3
+				REQUIRE(visited[0] == 302);
+				REQUIRE(visited[1] == 303);
+				REQUIRE(visited[2] == 304);
+
+				size_t count = 0;
+				linear_view.for_each([&](size_t x, size_t y, unsigned& item) { count++; });
+				REQUIRE(count == 8 * 5);
+			}
+		}
+	}
+}
+
+SCENARIO("Resource storage follows its allocation policy", "[resource]")
+{
+	GIVEN("Resources with the default, uninitialized, huge page and arena policies")
+	{
+		cg::allocation_policy uninitialized;
+		uninitialized.uninitialized = true;
+		cg::allocation_policy huge_pages;
+		huge_pages.huge_pages = true;
+
+		alignas(64) static unsigned char arena_buffer[64 * 1024];
+		std::pmr::monotonic_buffer_resource arena(
+			arena_buffer, sizeof(arena_buffer), std::pmr::null_memory_resource());
+		cg::allocation_policy arena_policy;
+		arena_policy.arena = &arena;
+
+		cg::resource<float> zeroed(100, 30);
+		cg::resource<float> uninitialized_resource(100, 30, uninitialized);
+		cg::resource<float> huge_page_resource(1024, 1024, huge_pages);
+		cg::resource<cg::unsigned_color> arena_resource(16, 16, 8, 8, arena_policy);
+
+		THEN("Storage is aligned to a cache line")
+		{
+			for (const void* data :
+				 { static_cast<const void*>(zeroed.get_data()),
+				   static_cast<const void*>(uninitialized_resource.get_data()),
+				   static_cast<const void*>(arena_resource.get_data()) })
+				REQUIRE(reinterpret_cast<uintptr_t>(data) % 64 == 0);
+			REQUIRE(
+				reinterpret_cast<uintptr_t>(huge_page_resource.get_data()) %
+					cg::resource_allocator<float>::huge_page_size ==
+				0);
+		}
+
+		THEN("Default resources are zeroed")
+		{
+			for (float value : zeroed.get_span())
+				REQUIRE(value == 0.f);
+		}
+
+		THEN("Arena resources are in the arena")
+		{
+			const unsigned char* data =
+				reinterpret_cast<const unsigned char*>(arena_resource.get_data());
+			REQUIRE(data >= arena_buffer);
+			REQUIRE(data + arena_resource.get_size_in_bytes() <= arena_buffer + sizeof(arena_buffer));
+		}
+
+		WHEN("The span of a resource is written")
+		{
+			cg::span<float> span = uninitialized_resource.get_span();
+			REQUIRE(span.size == 100 * 30);
+			for (size_t i = 0; i < span.size; i++)
+				span[i] = static_cast<float>(i);
+
+			THEN("Items are changed")
+			{
+				REQUIRE(uninitialized_resource.item(7, 2) == 207.f);
+			}
+		}
+	}
+}
+
 SCENARIO("Rasterizer can clear render target", "[rasterizer]")
 {
 	GIVEN("Dummy rasterizer with unsigned char render target")
@@ -0,0 +1,122 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cfloat>
+
+
+SCENARIO("Rasterizer clips triangles in clip space")
+{
+	GIVEN("Render target, depth buffer, and rasterizer with clip-space vertices")
+	{
+		const size_t size = 64;
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto depth_buffer = std::make_shared<cg::resource<float>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_render_target(render_target, depth_buffer);
+		rasterizer.set_viewport(size, size);
+
+		// w comes from the nx attribute
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			vertex.w = vertex_data.nx;
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [](cg::vertex vertex_data, float depth) {
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(3);
+		rasterizer.set_vertex_buffer(vertex_buffer);
+
+		WHEN("Draw a triangle crossing the near plane")
+		{
+			vertex_buffer->item(0) = { -1.f, -1.f, 0.5f, 1.f };
+			vertex_buffer->item(1) = { 1.f, -1.f, 0.5f, 1.f };
+			vertex_buffer->item(2) = { 0.f, 1.f, -1.f, 1.f };
+
+			rasterizer.clear_render_target({ 0, 0, 0 }, 1.f);
+			rasterizer.draw(3, 0);
+
+			THEN("Only the part in front of the near plane is drawn")
+			{
+				// The near plane cuts the triangle at y = -1/3, row 42.67
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						if (y <= 42)
+							REQUIRE(render_target->item(x, y).r == 0);
+						REQUIRE(depth_buffer->item(x, y) >= 0.f);
+					}
+				}
+				REQUIRE(render_target->item(32, 50).r == 255);
+				REQUIRE(render_target->item(20, 60).r == 255);
+			}
+		}
+
+		WHEN("Draw a triangle far beyond the guard band")
+		{
+			vertex_buffer->item(0) = { -1.f, -1.f, 0.5f, 1.f };
+			vertex_buffer->item(1) = { 20000.f, -40000.f, 0.5f, 1.f };
+			vertex_buffer->item(2) = { -1.f, 1.f, 0.5f, 1.f };
+
+			rasterizer.clear_render_target({ 0, 0, 0 }, 1.f);
+			rasterizer.draw(3, 0);
+
+			THEN("Coverage matches the unclipped triangle")
+			{
+				// Distances to the edges in screen space, pixels close to the edges
+				// are skipped
+				double screen_x[3], screen_y[3];
+				for (size_t i = 0; i < 3; i++)
+				{
+					screen_x[i] = (vertex_buffer->item(i).x + 1.0) * size / 2.0;
+					screen_y[i] = (1.0 - vertex_buffer->item(i).y) * size / 2.0;
+				}
+
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						double distances[3];
+						double nearest = DBL_MAX;
+						for (size_t i = 0; i < 3; i++)
+						{
+							size_t j = (i + 1) % 3;
+							double dx = screen_x[j] - screen_x[i];
+							double dy = screen_y[j] - screen_y[i];
+							distances[i] = ((x - screen_x[i]) * dy - (y - screen_y[i]) * dx) /
+										   std::sqrt(dx * dx + dy * dy);
+							nearest = std::min(nearest, std::abs(distances[i]));
+						}
+						if (nearest < 0.01)
+							continue;
+
+						bool inside = distances[0] > 0 && distances[1] > 0 && distances[2] > 0;
+						REQUIRE((render_target->item(x, y).r == 255) == inside);
+					}
+				}
+			}
+		}
+
+		WHEN("Draw a triangle outside of the frustum")
+		{
+			vertex_buffer->item(0) = { 1.5f, -1.f, 0.5f, 1.f };
+			vertex_buffer->item(1) = { 3.f, -1.f, 0.5f, 1.f };
+			vertex_buffer->item(2) = { 1.5f, 1.f, 0.5f, 1.f };
+
+			rasterizer.clear_render_target({ 0, 0, 0 }, 1.f);
+			rasterizer.draw(3, 0);
+
+			THEN("Nothing is shaded")
+			{
+				REQUIRE(rasterizer.get_statistics().shaded_fragments == 0);
+			}
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+namespace
+{
+// Screen-aligned quad at a constant depth
+void set_quad(cg::resource<cg::vertex>& buffer, size_t offset, float extent, float z)
+{
+	buffer.item(offset + 0) = { -extent, -extent, z };
+	buffer.item(offset + 1) = { extent, -extent, z };
+	buffer.item(offset + 2) = { extent, extent, z };
+	buffer.item(offset + 3) = { -extent, -extent, z };
+	buffer.item(offset + 4) = { extent, extent, z };
+	buffer.item(offset + 5) = { -extent, extent, z };
+}
+} // namespace
+
+SCENARIO("Command list records draws and executes them later")
+{
+	GIVEN("Render targets, depth buffers, and rasterizers")
+	{
+		const size_t size = 32;
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		rasterizer_type rasterizers[2];
+		std::shared_ptr<cg::resource<cg::unsigned_color>> render_targets[2];
+		std::shared_ptr<cg::resource<float>> depth_buffers[2];
+
+		auto vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		for (size_t i = 0; i < 2; i++)
+		{
+			render_targets[i] = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+			depth_buffers[i] = std::make_shared<cg::resource<float>>(size, size);
+			rasterizers[i].set_render_target(render_targets[i], depth_buffers[i]);
+			rasterizers[i].set_viewport(size, size);
+			rasterizers[i].vertex_shader = vertex_shader;
+			rasterizers[i].clear_render_target({ 0, 0, 0 });
+		}
+
+		cg::renderer::command_list<cg::vertex> commands;
+		commands.vertex_shader = vertex_shader;
+
+		WHEN("Draws with their own buffers and shader constants are executed")
+		{
+			const size_t num_draws = 8;
+			const size_t num_triangles = 20;
+
+			// The reference draws immediately with the same bindings
+			for (size_t draw = 0; draw < num_draws; draw++)
+			{
+				auto vertex_buffer =
+					random_scene::make_triangles(num_triangles, static_cast<unsigned>(17 + draw));
+
+				const float constant = static_cast<float>(draw + 1) / num_draws;
+				auto pixel_shader = [constant](cg::vertex vertex_data, float z) {
+					return cg::color{ constant, z, 0.f };
+				};
+
+				commands.set_vertex_buffer(vertex_buffer);
+				commands.pixel_shader = pixel_shader;
+				commands.draw(num_triangles * 3, 0);
+
+				rasterizers[0].set_vertex_buffer(vertex_buffer);
+				rasterizers[0].pixel_shader = pixel_shader;
+				rasterizers[0].draw(num_triangles * 3, 0);
+			}
+
+			// The draws of the list are set up in parallel
+			rasterizers[1].parallel_vertex_processing = true;
+			rasterizers[1].execute(commands);
+
+			THEN("Result is the same as of the immediate draws")
+			{
+				random_scene::require_equal(*render_targets[0], *render_targets[1], size, size);
+				random_scene::require_equal(*depth_buffers[0], *depth_buffers[1], size, size);
+				REQUIRE(
+					rasterizers[1].get_statistics().submitted_triangles ==
+					num_draws * num_triangles);
+			}
+		}
+
+		WHEN("A far quad is recorded before a near quad which hides it")
+		{
+			auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(12);
+			set_quad(*vertex_buffer, 0, 0.5f, 0.8f);
+			set_quad(*vertex_buffer, 6, 1.f, 0.2f);
+
+			commands.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 1.f, 1.f, 1.f };
+			};
+			commands.set_vertex_buffer(vertex_buffer);
+			commands.draw(6, 0);
+			commands.draw(6, 6);
+
+			auto bound_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+			set_quad(*bound_buffer, 0, 0.5f, 0.1f);
+			rasterizers[1].set_vertex_buffer(bound_buffer);
+			rasterizers[1].pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 1.f, 0.f, 0.f };
+			};
+			rasterizers[1].execute(commands);
+
+			THEN("The near quad is drawn first and the far one is rejected")
+			{
+				const auto& statistics = rasterizers[1].get_statistics();
+				REQUIRE(statistics.shaded_fragments == size * size);
+				REQUIRE(statistics.culled_tiles > 0);
+			}
+
+			THEN("Bindings of the rasterizer are kept")
+			{
+				rasterizers[1].draw(6, 0);
+				REQUIRE(render_targets[1]->item(size / 2, size / 2).r == 255);
+				REQUIRE(render_targets[1]->item(size / 2, size / 2).g == 0);
+			}
+		}
+
+		WHEN("Opaque and transparent draws are recorded")
+		{
+			auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(24);
+			const float depths[4] = { 0.8f, 0.1f, 0.5f, 0.9f };
+			const bool opaque[4] = { true, false, true, false };
+			for (size_t i = 0; i < 4; i++)
+				set_quad(*vertex_buffer, i * 6, 0.5f, depths[i]);
+
+			std::vector<size_t> executed;
+			commands.set_vertex_buffer(vertex_buffer);
+			for (size_t i = 0; i < 4; i++)
+			{
+				commands.pixel_shader = [&executed, i](cg::vertex vertex_data, float z) {
+					if (executed.empty() || executed.back() != i)
+						executed.push_back(i);
+					return cg::color{ 1.f, 1.f, 1.f };
+				};
+				commands.opaque = opaque[i];
+				commands.draw(6, i * 6);
+			}
+
+			// Without a depth buffer every draw is shaded
+			rasterizer_type rasterizer;
+			rasterizer.set_render_target(render_targets[1]);
+			rasterizer.set_viewport(size, size);
+			rasterizer.execute(commands);
+
+			THEN("Opaque draws run front-to-back, then transparent ones in their order")
+			{
+				REQUIRE(executed == std::vector<size_t>{ 2, 0, 1, 3 });
+			}
+		}
+
+		WHEN("A draw of the list reads outside of its buffers")
+		{
+			auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(12);
+			set_quad(*vertex_buffer, 0, 0.5f, 0.8f);
+			set_quad(*vertex_buffer, 6, 1.f, 0.2f);
+			auto index_buffer = std::make_shared<cg::resource<uint32_t>>(3);
+			index_buffer->item(0) = 0;
+			index_buffer->item(1) = 1;
+			index_buffer->item(2) = 12;
+
+			commands.set_vertex_buffer(vertex_buffer);
+			commands.draw(6, 0);
+			commands.draw(6, 6);
+			commands.draw(6, 12);
+			commands.set_index_buffer(index_buffer);
+			commands.draw_indexed(3, 0);
+
+			THEN("Execution throws while the draws are set up in parallel")
+			{
+				rasterizers[1].parallel_vertex_processing = true;
+				REQUIRE_THROWS(rasterizers[1].execute(commands));
+			}
+		}
+	}
+}
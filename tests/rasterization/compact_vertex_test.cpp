@@ -0,0 +1,195 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <random>
+
+
+SCENARIO("Octahedral encoding keeps unit vectors")
+{
+	GIVEN("Random unit vectors")
+	{
+		std::default_random_engine generator(5);
+		std::normal_distribution<float> distribution(0.f, 1.f);
+
+		THEN("Decoded vectors are within the quantization error of the encoded ones")
+		{
+			// Half of a 16 bit step is 1.5e-5, the fold of the octahedron
+			// stretches it a few times
+			float max_error = 0.f;
+			for (size_t i = 0; i < 10000; i++)
+			{
+				float3 normal = normalize(float3{
+					distribution(generator), distribution(generator), distribution(generator) });
+				float3 decoded = cg::decode_octahedral(cg::encode_octahedral(normal));
+				REQUIRE(std::abs(length(decoded) - 1.f) < 1.e-5f);
+				max_error = std::max(max_error, length(decoded - normal));
+			}
+			REQUIRE(max_error < 1.e-4f);
+		}
+
+		THEN("Encoding of a decoded vector is stable")
+		{
+			for (size_t i = 0; i < 10000; i++)
+			{
+				float3 normal = normalize(float3{
+					distribution(generator), distribution(generator), distribution(generator) });
+				cg::octahedral_normal encoded = cg::encode_octahedral(normal);
+				cg::octahedral_normal reencoded =
+					cg::encode_octahedral(cg::decode_octahedral(encoded));
+				REQUIRE(std::abs(reencoded.u - encoded.u) <= 1);
+				REQUIRE(std::abs(reencoded.v - encoded.v) <= 1);
+			}
+		}
+
+		THEN("Axes are encoded exactly")
+		{
+			REQUIRE(length(cg::decode_octahedral(cg::encode_octahedral({ 0.f, 0.f, 1.f })) -
+						   float3{ 0.f, 0.f, 1.f }) == 0.f);
+			REQUIRE(length(cg::decode_octahedral(cg::encode_octahedral({ 0.f, 0.f, -1.f })) -
+						   float3{ 0.f, 0.f, -1.f }) == 0.f);
+			REQUIRE(length(cg::decode_octahedral(cg::encode_octahedral({ -1.f, 0.f, 0.f })) -
+						   float3{ -1.f, 0.f, 0.f }) == 0.f);
+		}
+	}
+}
+
+SCENARIO("Rasterizer draws compact vertices")
+{
+	GIVEN("Rasterizer with compact vertices and a material table")
+	{
+		const size_t size = 32;
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		std::vector<cg::material> materials(2);
+		materials[1].diffuse = float3{ 1.f, 0.5f, 0.f };
+
+		cg::renderer::rasterizer<cg::compact_vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+		rasterizer.vertex_shader = [](float4 vertex, cg::compact_vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+
+		// Normals of all pixels face the viewer
+		bool normals_valid = true;
+		rasterizer.pixel_shader = [&](const cg::decoded_vertex<cg::compact_vertex>& vertex_data,
+									   float z) {
+			float3 normal =
+				normalize(cg::vertex_layout<cg::compact_vertex>::get_normal(vertex_data));
+			normals_valid &= std::abs(length(normal) - 1.f) < 1.e-5f && normal.z > 0.5f;
+			const cg::material& material = materials[vertex_data.material_id];
+			return cg::color{ material.diffuse.x, material.diffuse.y, material.diffuse.z };
+		};
+
+		float3 normals[3] = { normalize(float3{ -0.3f, 0.f, 1.f }),
+							  normalize(float3{ 0.3f, 0.f, 1.f }),
+							  normalize(float3{ 0.f, 0.3f, 1.f }) };
+		float2 positions[3] = { { -1.f, -1.f }, { 1.f, -1.f }, { -1.f, 1.f } };
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::compact_vertex>>(3);
+		for (size_t i = 0; i < 3; i++)
+		{
+			cg::octahedral_normal normal = cg::encode_octahedral(normals[i]);
+			vertex_buffer->item(i) = { positions[i].x, positions[i].y, 0.5f, normal.u,
+									   normal.v, 1 };
+		}
+		rasterizer.set_vertex_buffer(vertex_buffer);
+
+		WHEN("Draw a triangle")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 0);
+
+			THEN("Normals are interpolated and colors come from the material table")
+			{
+				REQUIRE(rasterizer.get_statistics().shaded_fragments > 0);
+				REQUIRE(normals_valid);
+				REQUIRE(render_target->item(4, 20).r == 255);
+				REQUIRE(render_target->item(4, 20).g == 127);
+				REQUIRE(render_target->item(4, 20).b == 0);
+			}
+		}
+	}
+
+	THEN("Compact vertices take less than half of the memory")
+	{
+		REQUIRE(2 * sizeof(cg::compact_vertex) < sizeof(cg::vertex));
+	}
+}
+
+SCENARIO("Encoded normals are interpolated decoded")
+{
+	GIVEN("A triangle with normals across the fold of the octahedron")
+	{
+		const size_t size = 32;
+		float3 normals[3] = { normalize(float3{ 0.7f, 0.f, 0.7f }),
+							  normalize(float3{ 0.7f, 0.f, -0.7f }),
+							  normalize(float3{ 0.f, 0.7f, -0.7f }) };
+		float2 positions[3] = { { -1.f, -1.f }, { 1.f, -1.f }, { -1.f, 1.f } };
+
+		auto compact_buffer = std::make_shared<cg::resource<cg::compact_vertex>>(3);
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(3);
+		for (size_t i = 0; i < 3; i++)
+		{
+			cg::octahedral_normal normal = cg::encode_octahedral(normals[i]);
+			compact_buffer->item(i) = { positions[i].x, positions[i].y, 0.5f, normal.u,
+										normal.v, 0 };
+			vertex_buffer->item(i) = { positions[i].x, positions[i].y, 0.5f,
+									   normals[i].x, normals[i].y, normals[i].z };
+		}
+
+		// Normals per pixel, the reference interpolates them as xyz
+		std::vector<float3> compact_normals(size * size);
+		std::vector<float3> reference_normals(size * size);
+
+		cg::renderer::rasterizer<cg::compact_vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_render_target(
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size));
+		rasterizer.set_viewport(size, size);
+		rasterizer.set_vertex_buffer(compact_buffer);
+		rasterizer.vertex_shader = [](float4 vertex, cg::compact_vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [&](const cg::decoded_vertex<cg::compact_vertex>& vertex_data,
+									   float z) {
+			compact_normals[static_cast<size_t>(vertex_data.y) * size +
+							static_cast<size_t>(vertex_data.x)] =
+				normalize(cg::vertex_layout<cg::compact_vertex>::get_normal(vertex_data));
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> reference;
+		reference.set_render_target(
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size));
+		reference.set_viewport(size, size);
+		reference.set_vertex_buffer(vertex_buffer);
+		reference.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		reference.pixel_shader = [&](const cg::vertex& vertex_data, float z) {
+			reference_normals[static_cast<size_t>(vertex_data.y) * size +
+							  static_cast<size_t>(vertex_data.x)] =
+				normalize(cg::vertex_layout<cg::vertex>::get_normal(vertex_data));
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		WHEN("Draw the triangle")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 0);
+			reference.clear_render_target({ 0, 0, 0 });
+			reference.draw(3, 0);
+
+			THEN("Normals are the same as of the interpolated vectors")
+			{
+				REQUIRE(rasterizer.get_statistics().shaded_fragments > 0);
+				for (size_t p = 0; p < size * size; p++)
+					REQUIRE(length(compact_normals[p] - reference_normals[p]) < 1.e-4f);
+			}
+		}
+	}
+}
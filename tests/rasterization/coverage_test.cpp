@@ -0,0 +1,124 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+
+// The test is built with the SSE kernels and, in the Scalar configuration,
+// with the scalar ones, so both are checked against the same reference
+namespace
+{
+// Pixels of a triangle under the top-left fill rule, evaluated per pixel
+// from the vertices snapped to the sub-pixel grid as the rasterizer does
+std::vector<bool> get_reference_coverage(
+	const cg::vertex* vertices, size_t width, size_t height)
+{
+	const float viewport_width = static_cast<float>(width);
+	const float viewport_height = static_cast<float>(height);
+	const int64_t subpixel_scale = 16;
+
+	int64_t x[3], y[3];
+	for (size_t i = 0; i < 3; i++)
+	{
+		float screen_x = (vertices[i].x + 1.f) * viewport_width / 2.f;
+		float screen_y = (-vertices[i].y + 1.f) * viewport_height / 2.f;
+		x[i] = std::lround(screen_x * static_cast<float>(subpixel_scale));
+		y[i] = std::lround(screen_y * static_cast<float>(subpixel_scale));
+	}
+
+	std::vector<bool> coverage(width * height, false);
+	int64_t area = (x[2] - x[0]) * (y[1] - y[0]) - (y[2] - y[0]) * (x[1] - x[0]);
+	if (area == 0)
+		return coverage;
+	if (area < 0)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+	}
+
+	for (size_t py = 0; py < height; py++)
+	{
+		for (size_t px = 0; px < width; px++)
+		{
+			bool inside = true;
+			for (size_t i = 0; i < 3; i++)
+			{
+				size_t j = (i + 1) % 3;
+				int64_t value =
+					(static_cast<int64_t>(px) * subpixel_scale - x[i]) * (y[j] - y[i]) -
+					(static_cast<int64_t>(py) * subpixel_scale - y[i]) * (x[j] - x[i]);
+				bool top_edge = y[i] == y[j] && x[j] < x[i];
+				bool left_edge = y[j] > y[i];
+				if (value + (top_edge || left_edge ? 0 : -1) < 0)
+					inside = false;
+			}
+			coverage[py * width + px] = inside;
+		}
+	}
+	return coverage;
+}
+} // namespace
+
+SCENARIO("Coverage of the block kernels matches the per-pixel edge functions")
+{
+	GIVEN("Large and small random triangles, render target, and rasterizer")
+	{
+		// Not multiples of the block size, so the border blocks are partial
+		const size_t width = 100;
+		const size_t height = 70;
+		const size_t num_triangles = 100;
+
+		auto vertex_buffer = random_scene::make_triangles(2 * num_triangles, 5);
+		// Triangles of the second half shrink to a few pixels around their
+		// first vertex
+		for (size_t i = 3 * num_triangles; i < 6 * num_triangles; i++)
+		{
+			const cg::vertex& first = vertex_buffer->item(i - i % 3);
+			cg::vertex& vertex = vertex_buffer->item(i);
+			vertex.x = first.x + (vertex.x - first.x) * 0.05f;
+			vertex.y = first.y + (vertex.y - first.y) * 0.05f;
+		}
+
+		auto render_target = std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_render_target(render_target);
+		random_scene::bind(rasterizer, vertex_buffer, width, height);
+		rasterizer.face_culling = decltype(rasterizer)::cull_mode::none;
+		rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		WHEN("Every triangle is drawn alone")
+		{
+			THEN("Exactly the pixels of the reference are covered")
+			{
+				for (size_t triangle = 0; triangle < 2 * num_triangles; triangle++)
+				{
+					rasterizer.clear_render_target({ 0, 0, 0 });
+					rasterizer.draw(3, 3 * triangle);
+
+					const auto reference =
+						get_reference_coverage(&vertex_buffer->item(3 * triangle), width, height);
+					size_t mismatches = 0;
+					for (size_t y = 0; y < height; y++)
+					{
+						for (size_t x = 0; x < width; x++)
+						{
+							bool covered = render_target->item(x, y).r == 255;
+							if (covered != reference[y * width + x])
+								mismatches++;
+						}
+					}
+					INFO("Triangle " << triangle);
+					REQUIRE(mismatches == 0);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Depth pre-pass shades every visible pixel once")
+{
+	GIVEN("Random overlapping triangles, render targets, depth buffers, and rasterizers")
+	{
+		const size_t width = 64;
+		const size_t height = 48;
+		const size_t num_triangles = 300;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 7);
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+		auto prepass_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto prepass_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> prepass_rasterizer;
+		rasterizer.set_render_target(render_target, depth_buffer);
+		prepass_rasterizer.set_render_target(prepass_render_target, prepass_depth_buffer);
+		prepass_rasterizer.depth_prepass = true;
+
+		for (auto* current : { &rasterizer, &prepass_rasterizer })
+			random_scene::bind(*current, vertex_buffer, width, height);
+
+		WHEN("Clear and draw with and without the pre-pass")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			prepass_rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			prepass_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Images and depth buffers are equal")
+			{
+				random_scene::require_equal(*render_target, *prepass_render_target, width, height);
+				random_scene::require_equal(*depth_buffer, *prepass_depth_buffer, width, height);
+			}
+
+			THEN("Pixel shader runs once per covered pixel")
+			{
+				size_t covered_pixels = 0;
+				for (size_t i = 0; i < prepass_depth_buffer->get_number_of_elements(); i++)
+				{
+					if (prepass_depth_buffer->item(i) != FLT_MAX)
+						covered_pixels++;
+				}
+
+				REQUIRE(prepass_rasterizer.get_statistics().shaded_fragments == covered_pixels);
+				REQUIRE(rasterizer.get_statistics().shaded_fragments > covered_pixels);
+			}
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Rasterizer culls triangles by facing and counts them")
+{
+	GIVEN("Front-facing, back-facing, off-screen, and near-crossing triangles")
+	{
+		const size_t size = 64;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(12);
+		// Counter-clockwise in the top left
+		vertex_buffer->item(0) = { -0.9f, 0.1f, 0.5f };
+		vertex_buffer->item(1) = { -0.1f, 0.1f, 0.5f };
+		vertex_buffer->item(2) = { -0.5f, 0.9f, 0.5f };
+		// Clockwise in the top right
+		vertex_buffer->item(3) = { 0.1f, 0.1f, 0.5f };
+		vertex_buffer->item(4) = { 0.5f, 0.9f, 0.5f };
+		vertex_buffer->item(5) = { 0.9f, 0.1f, 0.5f };
+		// Right of the frustum
+		vertex_buffer->item(6) = { 1.5f, -1.f, 0.5f };
+		vertex_buffer->item(7) = { 3.f, -1.f, 0.5f };
+		vertex_buffer->item(8) = { 1.5f, 1.f, 0.5f };
+		// Counter-clockwise in the bottom, crosses the near plane
+		vertex_buffer->item(9) = { -0.9f, -0.9f, 0.5f };
+		vertex_buffer->item(10) = { 0.9f, -0.9f, 0.5f };
+		vertex_buffer->item(11) = { 0.f, -0.1f, -1.f };
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [](cg::vertex vertex_data, float depth) {
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		auto count_pixels = [&]() {
+			size_t pixels = 0;
+			for (size_t i = 0; i < render_target->get_number_of_elements(); i++)
+			{
+				if (render_target->item(i).r == 255)
+					pixels++;
+			}
+			return pixels;
+		};
+
+		// Centers of the front-facing, back-facing and near-crossing triangles
+		const size_t front_x = 16, back_x = 48, top_y = 20;
+		const size_t bottom_x = 32, bottom_y = 58;
+
+		WHEN("Back faces are culled")
+		{
+			rasterizer.face_culling =
+				cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>::cull_mode::back;
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Only front faces are drawn")
+			{
+				REQUIRE(render_target->item(front_x, top_y).r == 255);
+				REQUIRE(render_target->item(back_x, top_y).r == 0);
+				REQUIRE(render_target->item(bottom_x, bottom_y).r == 255);
+			}
+
+			THEN("Statistics count every triangle")
+			{
+				const auto& statistics = rasterizer.get_statistics();
+				REQUIRE(statistics.submitted_triangles == 4);
+				REQUIRE(statistics.culled_triangles == 2);
+				REQUIRE(statistics.clipped_triangles == 1);
+				REQUIRE(statistics.rasterized_triangles == 3);
+				REQUIRE(statistics.shaded_fragments == count_pixels());
+			}
+		}
+
+		WHEN("Front faces are culled")
+		{
+			rasterizer.face_culling =
+				cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>::cull_mode::front;
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Only back faces are drawn")
+			{
+				REQUIRE(render_target->item(front_x, top_y).r == 0);
+				REQUIRE(render_target->item(back_x, top_y).r == 255);
+				REQUIRE(render_target->item(bottom_x, bottom_y).r == 0);
+				REQUIRE(rasterizer.get_statistics().culled_triangles == 3);
+				REQUIRE(rasterizer.get_statistics().rasterized_triangles == 1);
+			}
+		}
+
+		WHEN("Nothing is culled")
+		{
+			rasterizer.face_culling =
+				cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>::cull_mode::none;
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Both facings are drawn")
+			{
+				REQUIRE(render_target->item(front_x, top_y).r == 255);
+				REQUIRE(render_target->item(back_x, top_y).r == 255);
+				REQUIRE(render_target->item(bottom_x, bottom_y).r == 255);
+				REQUIRE(rasterizer.get_statistics().culled_triangles == 1);
+				REQUIRE(rasterizer.get_statistics().shaded_fragments == count_pixels());
+			}
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <random>
+
+
+SCENARIO("Fast clear fills tiles lazily")
+{
+	GIVEN("Render targets with stale content, depth buffers, and rasterizers")
+	{
+		const size_t width = 64;
+		const size_t height = 40;
+		const size_t num_triangles = 20;
+
+		std::default_random_engine generator(3);
+		std::uniform_real_distribution<float> position(-0.6f, 0.2f);
+		std::uniform_real_distribution<float> value(0.f, 1.f);
+
+		auto vertex_buffer =
+			std::make_shared<cg::resource<cg::vertex>>(num_triangles * 3);
+		for (size_t i = 0; i < vertex_buffer->get_number_of_elements(); i++)
+		{
+			cg::vertex& vertex = vertex_buffer->item(i);
+			vertex.x = position(generator);
+			vertex.y = position(generator);
+			vertex.z = value(generator);
+			vertex.diffuse_r = value(generator);
+		}
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		rasterizer_type rasterizers[4];
+		std::shared_ptr<cg::resource<cg::unsigned_color>> render_targets[4];
+		std::shared_ptr<cg::resource<float>> depth_buffers[4];
+
+		// Reference, fast clear, tiled fast clear, and fast clear with 4x MSAA,
+		// the last one is compared with a multisampled reference
+		rasterizers[1].fast_clear = true;
+		rasterizers[2].fast_clear = true;
+		rasterizers[2].tiled_rasterization = true;
+		rasterizers[2].tile_size = 16;
+		rasterizers[3].fast_clear = true;
+		rasterizers[3].sample_count = 4;
+
+		auto vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		auto pixel_shader = [](cg::vertex vertex_data, float depth) {
+			return cg::color{ vertex_data.diffuse_r, depth, 1.f };
+		};
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			const size_t samples = rasterizers[i].sample_count;
+			render_targets[i] =
+				std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+			depth_buffers[i] = std::make_shared<cg::resource<float>>(width * samples, height);
+			for (size_t p = 0; p < render_targets[i]->get_number_of_elements(); p++)
+				render_targets[i]->item(p) = { 7, 7, 7 };
+			for (size_t p = 0; p < depth_buffers[i]->get_number_of_elements(); p++)
+				depth_buffers[i]->item(p) = -1.f;
+
+			rasterizers[i].set_render_target(render_targets[i], depth_buffers[i]);
+			rasterizers[i].set_vertex_buffer(vertex_buffer);
+			rasterizers[i].set_viewport(width, height);
+			rasterizers[i].vertex_shader = vertex_shader;
+			rasterizers[i].pixel_shader = pixel_shader;
+		}
+
+		WHEN("Clear and draw triangles in the top-left corner")
+		{
+			for (size_t i = 0; i < 4; i++)
+			{
+				rasterizers[i].clear_render_target({ 10, 20, 30 }, 1.f);
+				rasterizers[i].draw(num_triangles * 3, 0);
+			}
+
+			THEN("Untouched tiles keep the stale content until the clear is resolved")
+			{
+				REQUIRE(render_targets[1]->item(width - 1, height - 1).r == 7);
+				REQUIRE(depth_buffers[1]->item(width - 1, height - 1) == -1.f);
+
+				rasterizers[1].resolve_clear();
+				REQUIRE(render_targets[1]->item(width - 1, height - 1).r == 10);
+				REQUIRE(depth_buffers[1]->item(width - 1, height - 1) == 1.f);
+			}
+
+			THEN("Resolved targets are the same as after a full clear")
+			{
+				for (size_t i = 1; i < 3; i++)
+				{
+					rasterizers[i].resolve_clear();
+					for (size_t p = 0; p < render_targets[0]->get_number_of_elements(); p++)
+					{
+						const cg::unsigned_color& expected = render_targets[0]->item(p);
+						const cg::unsigned_color& result = render_targets[i]->item(p);
+						REQUIRE(result.r == expected.r);
+						REQUIRE(result.g == expected.g);
+						REQUIRE(result.b == expected.b);
+						REQUIRE(depth_buffers[i]->item(p) == depth_buffers[0]->item(p));
+					}
+				}
+			}
+
+			THEN("Multisampled targets are the same as after a full clear")
+			{
+				rasterizers[0].sample_count = 4;
+				auto depth_buffer = std::make_shared<cg::resource<float>>(width * 4, height);
+				rasterizers[0].set_render_target(nullptr, depth_buffer);
+				rasterizers[0].clear_render_target({ 10, 20, 30 }, 1.f);
+				rasterizers[0].draw(num_triangles * 3, 0);
+				rasterizers[0].resolve();
+
+				rasterizers[3].resolve();
+				rasterizers[3].resolve_clear();
+				for (size_t p = 0; p < render_targets[0]->get_number_of_elements(); p++)
+				{
+					const cg::unsigned_color& expected = render_targets[0]->item(p);
+					const cg::unsigned_color& result = render_targets[3]->item(p);
+					REQUIRE(result.r == expected.r);
+					REQUIRE(result.g == expected.g);
+					REQUIRE(result.b == expected.b);
+				}
+				for (size_t p = 0; p < depth_buffer->get_number_of_elements(); p++)
+					REQUIRE(depth_buffers[3]->item(p) == depth_buffer->item(p));
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Rasterizer shades pixels on shared edges exactly once")
+{
+	GIVEN("Two triangles sharing a diagonal of a square, render target, and rasterizer")
+	{
+		const size_t size = 16;
+		// Pixel coordinates of the square corners
+		const float left = 2.f, top = 2.f, right = 12.f, bottom = 12.f;
+		auto to_ndc = [&](float x, float y) {
+			cg::vertex vertex = {};
+			vertex.x = 2.f * x / size - 1.f;
+			vertex.y = 1.f - 2.f * y / size;
+			return vertex;
+		};
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+		vertex_buffer->item(0) = to_ndc(right, top);
+		vertex_buffer->item(1) = to_ndc(left, top);
+		vertex_buffer->item(2) = to_ndc(left, bottom);
+		vertex_buffer->item(3) = to_ndc(right, top);
+		vertex_buffer->item(4) = to_ndc(left, bottom);
+		vertex_buffer->item(5) = to_ndc(right, bottom);
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+
+		cg::resource<int> shading_count(size, size);
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [&](cg::vertex vertex_data, float depth) {
+			// Interpolated position is in screen space
+			shading_count.item(
+				static_cast<size_t>(std::lround(vertex_data.x)),
+				static_cast<size_t>(std::lround(vertex_data.y)))++;
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		WHEN("Clear and draw")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Top and left edges are included, bottom and right edges are not")
+			{
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						bool inside = x >= left && x < right && y >= top && y < bottom;
+						REQUIRE(shading_count.item(x, y) == (inside ? 1 : 0));
+						REQUIRE(render_target->item(x, y).r == (inside ? 255 : 0));
+					}
+				}
+			}
+		}
+	}
+}
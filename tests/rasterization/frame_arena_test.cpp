@@ -0,0 +1,376 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <atomic>
+#include <catch.hpp>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+
+// Every heap allocation is counted, which includes the containers of the
+// standard library and the over-aligned storage of resources. The array
+// forms and the nothrow ones, which call these, are counted too.
+namespace
+{
+std::atomic<size_t> heap_allocations{ 0 };
+
+void* allocate(std::size_t size, std::size_t alignment)
+{
+	heap_allocations++;
+	size = size ? size : 1;
+#ifdef _MSC_VER
+	void* pointer = _aligned_malloc(size, alignment);
+#else
+	// The size of aligned_alloc should be a multiple of the alignment
+	void* pointer = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void deallocate(void* pointer) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+	deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+	deallocate(pointer);
+}
+
+SCENARIO("Frame arena reuses its blocks")
+{
+	GIVEN("An arena with small blocks")
+	{
+		cg::frame_arena arena(256);
+
+		WHEN("Memory is allocated inside of a scope")
+		{
+			void* first = nullptr;
+			{
+				cg::frame_arena::scope scope(arena);
+				first = arena.allocate(100, 64);
+				void* second = arena.allocate(8, 8);
+				REQUIRE(reinterpret_cast<uintptr_t>(first) % 64 == 0);
+				REQUIRE(static_cast<char*>(second) >= static_cast<char*>(first) + 100);
+			}
+
+			THEN("It is released at the end of the scope")
+			{
+				REQUIRE(arena.allocate(100, 64) == first);
+				REQUIRE(arena.get_upstream_allocations() == 1);
+			}
+		}
+
+		WHEN("A frame outgrows the first block and the arena is reset")
+		{
+			auto frame = [&]() {
+				std::pmr::vector<int> values(&arena);
+				for (int i = 0; i < 1000; i++)
+					values.push_back(i);
+				return values.back();
+			};
+			REQUIRE(frame() == 999);
+			size_t upstream_allocations = arena.get_upstream_allocations();
+			arena.reset();
+
+			THEN("The next frames don't allocate")
+			{
+				REQUIRE(upstream_allocations > 1);
+				for (size_t i = 0; i < 3; i++)
+				{
+					REQUIRE(frame() == 999);
+					arena.reset();
+				}
+				REQUIRE(arena.get_upstream_allocations() == upstream_allocations);
+			}
+		}
+
+		WHEN("Threads allocate concurrently across the blocks")
+		{
+			const int num_allocations = 4000;
+			std::vector<int*> allocations(num_allocations);
+#pragma omp parallel for
+			for (int i = 0; i < num_allocations; i++)
+			{
+				allocations[i] = static_cast<int*>(arena.allocate(3 * sizeof(int), alignof(int)));
+				for (int j = 0; j < 3; j++)
+					allocations[i][j] = i;
+			}
+
+			THEN("Allocations don't overlap")
+			{
+				REQUIRE(arena.get_upstream_allocations() > 1);
+				for (int i = 0; i < num_allocations; i++)
+				{
+					for (int j = 0; j < 3; j++)
+						REQUIRE(allocations[i][j] == i);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("Allocations of resources are counted")
+{
+	GIVEN("The number of heap allocations")
+	{
+		const size_t before = heap_allocations;
+
+		WHEN("A resource and an array are allocated")
+		{
+			cg::resource<float> resource(16, 16);
+			const size_t after_resource = heap_allocations;
+			auto values = std::make_unique<float[]>(16);
+			const size_t after_array = heap_allocations;
+
+			THEN("Both the over-aligned storage and the array are counted")
+			{
+				REQUIRE(after_resource > before);
+				REQUIRE(after_array > after_resource);
+			}
+		}
+	}
+}
+
+SCENARIO("Rasterizer doesn't allocate in the steady state")
+{
+	GIVEN("Draws with a clipped triangle and an indexed quad")
+	{
+		const size_t size = 64;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(7);
+		// Crosses the near plane
+		vertex_buffer->item(0) = { -0.9f, -0.9f, -0.5f };
+		vertex_buffer->item(1) = { 0.9f, -0.9f, 0.5f };
+		vertex_buffer->item(2) = { 0.f, 0.9f, 0.5f };
+		vertex_buffer->item(3) = { -0.5f, -0.5f, 0.3f };
+		vertex_buffer->item(4) = { 0.5f, -0.5f, 0.3f };
+		vertex_buffer->item(5) = { 0.5f, 0.5f, 0.3f };
+		vertex_buffer->item(6) = { -0.5f, 0.5f, 0.3f };
+
+		auto index_buffer = std::make_shared<cg::resource<uint32_t>>(6);
+		const uint32_t indices[6] = { 3, 4, 5, 3, 5, 6 };
+		for (size_t i = 0; i < 6; i++)
+			index_buffer->item(i) = indices[i];
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+
+		WHEN("A frame is drawn again in every mode")
+		{
+			THEN("Only the first frame allocates")
+			{
+				for (size_t mode = 0; mode < 5; mode++)
+				{
+					rasterizer_type rasterizer;
+					rasterizer.tiled_rasterization = mode == 1;
+					rasterizer.tile_size = 16;
+					rasterizer.depth_prepass = mode == 2;
+					rasterizer.visibility_buffer = mode == 3;
+					rasterizer.sample_count = mode == 4 ? 4 : 1;
+
+					const size_t samples = rasterizer.sample_count;
+					rasterizer.set_render_target(
+						std::make_shared<cg::resource<cg::unsigned_color>>(size, size),
+						std::make_shared<cg::resource<float>>(size * samples, size));
+					rasterizer.set_viewport(size, size);
+					rasterizer.set_vertex_buffer(vertex_buffer);
+					rasterizer.set_index_buffer(index_buffer);
+					rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+						return std::make_pair(vertex, vertex_data);
+					};
+					rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+						return cg::color{ 1.f, 1.f, 1.f };
+					};
+
+					auto frame = [&]() {
+						rasterizer.clear_render_target({ 0, 0, 0 });
+						rasterizer.draw(3, 0);
+						rasterizer.draw_indexed(6, 0);
+						rasterizer.resolve();
+					};
+					frame();
+					REQUIRE(rasterizer.get_statistics().shaded_fragments > 0);
+					const size_t upstream_allocations =
+						rasterizer.get_arena()->get_upstream_allocations();
+
+					const size_t before = heap_allocations;
+					frame();
+					frame();
+					const size_t after = heap_allocations;
+
+					REQUIRE(after == before);
+					REQUIRE(rasterizer.get_arena()->get_upstream_allocations() ==
+							upstream_allocations);
+				}
+			}
+		}
+
+		WHEN("A command list with queries is executed again with fast clears")
+		{
+			rasterizer_type rasterizer;
+			rasterizer.fast_clear = true;
+			rasterizer.set_render_target(
+				std::make_shared<cg::resource<cg::unsigned_color>>(size, size),
+				std::make_shared<cg::resource<float>>(size, size));
+			rasterizer.set_viewport(size, size);
+			rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+				return std::make_pair(vertex, vertex_data);
+			};
+			rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 1.f, 1.f, 1.f };
+			};
+
+			cg::renderer::command_list<cg::vertex> commands(
+				rasterizer.vertex_shader, rasterizer.pixel_shader);
+			commands.set_vertex_buffer(vertex_buffer);
+			commands.set_index_buffer(index_buffer);
+			// The quad is the proxy of the triangle
+			commands.begin_query(0);
+			commands.color_write = false;
+			commands.depth_write = false;
+			commands.draw_indexed(6, 0);
+			commands.end_query();
+			commands.color_write = true;
+			commands.depth_write = true;
+			commands.set_predicate(0);
+			commands.draw(3, 0);
+			commands.set_predicate(cg::renderer::no_query);
+			commands.draw_indexed(6, 0);
+
+			auto frame = [&]() {
+				rasterizer.clear_render_target({ 0, 0, 0 });
+				rasterizer.execute(commands);
+				rasterizer.resolve_clear();
+			};
+			frame();
+			REQUIRE(rasterizer.get_statistics().shaded_fragments > 0);
+			REQUIRE(rasterizer.get_statistics().skipped_draws == 0);
+			const size_t upstream_allocations =
+				rasterizer.get_arena()->get_upstream_allocations();
+
+			const size_t before = heap_allocations;
+			frame();
+			frame();
+			const size_t after = heap_allocations;
+
+			THEN("Only the first frame allocates")
+			{
+				REQUIRE(after == before);
+				REQUIRE(rasterizer.get_arena()->get_upstream_allocations() ==
+						upstream_allocations);
+			}
+		}
+
+		WHEN("The arena is shared with the caller")
+		{
+			auto arena = std::make_shared<cg::frame_arena>();
+			rasterizer_type rasterizer;
+			rasterizer.set_arena(arena);
+			rasterizer.set_render_target(
+				std::make_shared<cg::resource<cg::unsigned_color>>(size, size),
+				std::make_shared<cg::resource<float>>(size, size));
+			rasterizer.set_viewport(size, size);
+			rasterizer.set_vertex_buffer(vertex_buffer);
+			rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+				return std::make_pair(vertex, vertex_data);
+			};
+			rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 1.f, 1.f, 1.f };
+			};
+			rasterizer.clear_render_target({ 0, 0, 0 });
+
+			// Memory of the caller stays allocated over the draw
+			std::pmr::vector<int> frame_data(16, 1, arena.get());
+			const auto marker = arena->get_marker();
+
+			cg::renderer::command_list<cg::vertex> commands(
+				rasterizer.vertex_shader, rasterizer.pixel_shader);
+			commands.set_vertex_buffer(vertex_buffer);
+			commands.draw(3, 0);
+			commands.draw(3, 0);
+
+			rasterizer.draw(3, 0);
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.execute(commands);
+
+			THEN("The scratch of the draws is released when they return")
+			{
+				REQUIRE(rasterizer.get_statistics().shaded_fragments > 0);
+				REQUIRE(arena->get_marker().block == marker.block);
+				REQUIRE(arena->get_marker().offset == marker.offset);
+				for (int value : frame_data)
+					REQUIRE(value == 1);
+			}
+		}
+	}
+}
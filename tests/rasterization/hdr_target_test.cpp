@@ -0,0 +1,244 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "renderer/rasterizer/tone_mapping.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cmath>
+#include <vector>
+
+
+SCENARIO("Float render targets keep the colors for the tone mapping")
+{
+	GIVEN("A triangle with colors across it, and 8-bit and float targets")
+	{
+		const size_t size = 48;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(3);
+		vertex_buffer->item(0) = { -0.9f, -0.9f, 0.5f };
+		vertex_buffer->item(1) = { 0.9f, -0.9f, 0.5f };
+		vertex_buffer->item(2) = { 0.f, 0.9f, 0.5f };
+		vertex_buffer->item(0).diffuse_r = 1.f;
+		vertex_buffer->item(1).diffuse_g = 1.f;
+		vertex_buffer->item(2).diffuse_b = 1.f;
+
+		auto vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		auto pixel_shader = [](cg::vertex vertex_data, float z) {
+			return cg::color{ vertex_data.diffuse_r, vertex_data.diffuse_g, vertex_data.diffuse_b };
+		};
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		auto render_target = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.vertex_shader = vertex_shader;
+		rasterizer.pixel_shader = pixel_shader;
+
+		cg::renderer::rasterizer<cg::vertex, cg::color> hdr_rasterizer;
+		auto hdr_target = std::make_shared<cg::resource<cg::color>>(size, size);
+		hdr_rasterizer.set_render_target(hdr_target);
+		hdr_rasterizer.set_viewport(size, size);
+		hdr_rasterizer.set_vertex_buffer(vertex_buffer);
+		hdr_rasterizer.vertex_shader = vertex_shader;
+		hdr_rasterizer.pixel_shader = pixel_shader;
+
+		WHEN("Both are drawn and the float target is resolved with the defaults")
+		{
+			rasterizer.clear_render_target({ 0, 0, 255 });
+			rasterizer.draw(3, 0);
+			hdr_rasterizer.clear_render_target({ 0.f, 0.f, 1.f });
+			hdr_rasterizer.draw(3, 0);
+
+			auto resolved = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+			cg::renderer::resolve_tone_mapping(*hdr_target, *resolved);
+
+			THEN("The result is the same as of the 8-bit target")
+			{
+				for (size_t p = 0; p < render_target->get_number_of_elements(); p++)
+				{
+					REQUIRE(resolved->item(p).r == render_target->item(p).r);
+					REQUIRE(resolved->item(p).g == render_target->item(p).g);
+					REQUIRE(resolved->item(p).b == render_target->item(p).b);
+				}
+			}
+		}
+
+		WHEN("A color above one is drawn with multisampling")
+		{
+			auto hdr_depth = std::make_shared<cg::resource<float>>(size * 4, size);
+			hdr_rasterizer.sample_count = 4;
+			hdr_rasterizer.set_render_target(hdr_target, hdr_depth);
+			hdr_rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 4.f, 0.25f, 0.f };
+			};
+			hdr_rasterizer.clear_render_target({ 0.f, 0.f, 0.f });
+			hdr_rasterizer.draw(3, 0);
+			hdr_rasterizer.resolve();
+
+			THEN("It isn't clamped and the edges are averaged in float")
+			{
+				const cg::color& center = hdr_target->item(size / 2, size / 2);
+				REQUIRE(center.r == 4.f);
+				REQUIRE(center.g == 0.25f);
+
+				bool partial = false;
+				for (size_t p = 0; p < hdr_target->get_number_of_elements(); p++)
+				{
+					const float r = hdr_target->item(p).r;
+					REQUIRE((r == 0.f || r == 1.f || r == 2.f || r == 3.f || r == 4.f));
+					partial |= r == 1.f || r == 2.f || r == 3.f;
+				}
+				REQUIRE(partial);
+			}
+		}
+	}
+}
+
+SCENARIO("Tone mapping resolves float targets into 8-bit ones")
+{
+	GIVEN("A float target with an odd number of pixels")
+	{
+		// 51 channels: three SIMD groups and a scalar tail
+		cg::resource<cg::color> hdr_target(17, 1);
+		cg::resource<cg::unsigned_color> target(17, 1);
+		for (size_t i = 0; i < 17; i++)
+		{
+			float value = static_cast<float>(i) / 16;
+			hdr_target.item(i) = cg::color{ value, value * 4.f, -value };
+		}
+
+		WHEN("It is resolved with the sRGB table")
+		{
+			cg::renderer::tone_mapping settings;
+			settings.srgb = true;
+			cg::renderer::resolve_tone_mapping(hdr_target, target, settings);
+
+			THEN("Channels are encoded, clamped and negative values are black")
+			{
+				for (size_t i = 0; i < 17; i++)
+				{
+					float value = std::min(static_cast<float>(i) / 16, 1.f);
+					float encoded = value <= 0.0031308f
+										? 12.92f * value
+										: 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+					REQUIRE(std::abs(target.item(i).r - encoded * 255.f) <= 1.f);
+					REQUIRE(target.item(i).b == 0);
+				}
+				REQUIRE(target.item(8).r == 188);
+				REQUIRE(target.item(16).r == 255);
+				REQUIRE(target.item(16).g == 255);
+			}
+		}
+
+		WHEN("It is resolved with exposure and the curves")
+		{
+			hdr_target.item(16) = cg::color{ 1.f, 100.f, NAN };
+			cg::renderer::tone_mapping settings;
+			settings.srgb = false;
+
+			settings.curve = cg::renderer::tone_curve::reinhard;
+			cg::renderer::resolve_tone_mapping(hdr_target, target, settings);
+			const cg::unsigned_color reinhard = target.item(16);
+
+			settings.exposure = 3.f;
+			cg::renderer::resolve_tone_mapping(hdr_target, target, settings);
+			const cg::unsigned_color exposed = target.item(16);
+
+			settings.exposure = 1.f;
+			settings.curve = cg::renderer::tone_curve::aces;
+			cg::renderer::resolve_tone_mapping(hdr_target, target, settings);
+
+			THEN("The curves map the values into the 8-bit range")
+			{
+				REQUIRE(reinhard.r == 127);
+				REQUIRE(reinhard.g == 252);
+				REQUIRE(reinhard.b == 0);
+				REQUIRE(exposed.r == 191);
+				REQUIRE(target.item(16).g == 255);
+				REQUIRE(target.item(16).b == 0);
+				REQUIRE(target.item(0).r == 0);
+				for (size_t i = 1; i < 17; i++)
+					REQUIRE(target.item(i).r >= target.item(i - 1).r);
+			}
+		}
+	}
+
+	GIVEN("Tiled targets")
+	{
+		cg::resource<cg::color> linear_hdr(20, 12);
+		cg::resource<cg::color> tiled_hdr(20, 12, 8, 8);
+		for (size_t y = 0; y < 12; y++)
+		{
+			for (size_t x = 0; x < 20; x++)
+			{
+				cg::color color{ x / 10.f, y / 6.f, (x + y) / 32.f };
+				linear_hdr.item(x, y) = color;
+				tiled_hdr.item(x, y) = color;
+			}
+		}
+
+		WHEN("They are resolved")
+		{
+			cg::resource<cg::unsigned_color> linear_target(20, 12);
+			cg::resource<cg::unsigned_color> tiled_target(20, 12, 8, 8);
+			// Padding holds what the resolve would choke on or overwrite
+			for (cg::color& padding : tiled_hdr.get_span())
+				padding = { NAN, NAN, NAN };
+			for (cg::unsigned_color& padding : tiled_target.get_span())
+				padding = { 1, 2, 3 };
+			for (size_t y = 0; y < 12; y++)
+			{
+				for (size_t x = 0; x < 20; x++)
+					tiled_hdr.item(x, y) = linear_hdr.item(x, y);
+			}
+			cg::renderer::resolve_tone_mapping(linear_hdr, linear_target);
+			cg::renderer::resolve_tone_mapping(tiled_hdr, tiled_target);
+
+			THEN("Pixels are the same as of the linear targets")
+			{
+				for (size_t y = 0; y < 12; y++)
+				{
+					for (size_t x = 0; x < 20; x++)
+					{
+						REQUIRE(tiled_target.item(x, y).r == linear_target.item(x, y).r);
+						REQUIRE(tiled_target.item(x, y).g == linear_target.item(x, y).g);
+						REQUIRE(tiled_target.item(x, y).b == linear_target.item(x, y).b);
+					}
+				}
+			}
+
+			THEN("Padding of the tiles isn't written")
+			{
+				const cg::span<cg::unsigned_color> storage = tiled_target.get_span();
+				std::vector<bool> pixels(storage.size, false);
+				for (size_t y = 0; y < 12; y++)
+				{
+					for (size_t x = 0; x < 20; x++)
+						pixels[&tiled_target.item(x, y) - storage.data] = true;
+				}
+				for (size_t i = 0; i < storage.size; i++)
+				{
+					if (pixels[i])
+						continue;
+					REQUIRE(storage[i].r == 1);
+					REQUIRE(storage[i].g == 2);
+					REQUIRE(storage[i].b == 3);
+				}
+			}
+		}
+
+		WHEN("The layouts differ")
+		{
+			cg::resource<cg::unsigned_color> linear_target(20, 12);
+
+			THEN("The resolve throws")
+			{
+				REQUIRE_THROWS(cg::renderer::resolve_tone_mapping(tiled_hdr, linear_target));
+			}
+		}
+	}
+}
@@ -0,0 +1,124 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Hierarchical depth test culls occluded tiles")
+{
+	GIVEN("Near and far full-screen triangles, render target, depth buffer, and rasterizer")
+	{
+		// One triangle per draw, so no tile of a draw is culled by the draw
+		// itself. The second triangle of a quad would be culled in the tiles
+		// which the first one covers at the same depth.
+		auto make_triangle = [](float z) {
+			std::vector<cg::vertex> triangle(3);
+			triangle[0] = { -1.f, -1.f, z };
+			triangle[1] = { 3.f, -1.f, z };
+			triangle[2] = { -1.f, 3.f, z };
+			return triangle;
+		};
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+		auto near_triangle = make_triangle(0.2f);
+		auto far_triangle = make_triangle(0.8f);
+		for (size_t i = 0; i < 3; i++)
+		{
+			vertex_buffer->item(i) = near_triangle[i];
+			vertex_buffer->item(i + 3) = far_triangle[i];
+		}
+
+		const size_t size = 32;
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto depth_buffer = std::make_shared<cg::resource<float>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.set_render_target(render_target, depth_buffer);
+		rasterizer.set_viewport(size, size);
+
+		size_t shaded_fragments = 0;
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [&](cg::vertex vertex_data, float depth) {
+			shaded_fragments++;
+			return cg::color{ depth, depth, depth };
+		};
+
+		WHEN("Near triangle is drawn before far triangle")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 0);
+			shaded_fragments = 0;
+			rasterizer.draw(3, 3);
+
+			THEN("All tiles of the far triangle are culled")
+			{
+				auto statistics = rasterizer.get_statistics();
+				REQUIRE(statistics.tested_tiles > 0);
+				REQUIRE(statistics.culled_tiles == statistics.tested_tiles);
+				REQUIRE(shaded_fragments == 0);
+			}
+
+			THEN("Depth buffer keeps the near triangle")
+			{
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						REQUIRE(depth_buffer->item(x, y) == 0.2f);
+					}
+				}
+			}
+		}
+
+		WHEN("Near quad covers the left half of the target before far triangle is drawn")
+		{
+			auto half_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+			half_buffer->item(0) = { 0.f, 1.f, 0.2f };
+			half_buffer->item(1) = { -1.f, 1.f, 0.2f };
+			half_buffer->item(2) = { -1.f, -1.f, 0.2f };
+			half_buffer->item(3) = { 0.f, 1.f, 0.2f };
+			half_buffer->item(4) = { -1.f, -1.f, 0.2f };
+			half_buffer->item(5) = { 0.f, -1.f, 0.2f };
+
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.set_vertex_buffer(half_buffer);
+			rasterizer.draw(6, 0);
+			rasterizer.set_vertex_buffer(vertex_buffer);
+			shaded_fragments = 0;
+			rasterizer.draw(3, 3);
+
+			THEN("Only the tiles written by the near quad are culled")
+			{
+				auto statistics = rasterizer.get_statistics();
+				REQUIRE(statistics.culled_tiles * 2 == statistics.tested_tiles);
+				REQUIRE(shaded_fragments == size * size / 2);
+			}
+		}
+
+		WHEN("Far triangle is drawn before near triangle")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 3);
+			rasterizer.draw(3, 0);
+
+			THEN("Nothing is culled and the near triangle is visible")
+			{
+				auto statistics = rasterizer.get_statistics();
+				REQUIRE(statistics.culled_tiles == 0);
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						REQUIRE(depth_buffer->item(x, y) == 0.2f);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Indexed draw shades every vertex once")
+{
+	GIVEN("Grid of quads as indexed and flat vertex buffers, render targets, and rasterizers")
+	{
+		const size_t cells = 4;
+		const size_t size = 32;
+
+		auto indexed_vertex_buffer =
+			std::make_shared<cg::resource<cg::vertex>>((cells + 1) * (cells + 1));
+		for (size_t y = 0; y <= cells; y++)
+		{
+			for (size_t x = 0; x <= cells; x++)
+			{
+				cg::vertex& vertex = indexed_vertex_buffer->item(y * (cells + 1) + x);
+				vertex = {};
+				vertex.x = 1.6f * x / cells - 0.8f;
+				vertex.y = 0.8f - 1.6f * y / cells;
+				vertex.z = 0.1f * (x + y);
+				vertex.diffuse_r = static_cast<float>(x) / cells;
+				vertex.diffuse_g = static_cast<float>(y) / cells;
+			}
+		}
+
+		auto index_buffer = std::make_shared<cg::resource<uint32_t>>(cells * cells * 6);
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(cells * cells * 6);
+		size_t index = 0;
+		for (uint32_t y = 0; y < cells; y++)
+		{
+			for (uint32_t x = 0; x < cells; x++)
+			{
+				uint32_t top_left = y * (cells + 1) + x;
+				uint32_t top_right = top_left + 1;
+				uint32_t bottom_left = top_left + (cells + 1);
+				uint32_t bottom_right = bottom_left + 1;
+				for (uint32_t id : { top_right, top_left, bottom_left, top_right, bottom_left,
+									 bottom_right })
+				{
+					index_buffer->item(index) = id;
+					vertex_buffer->item(index) = indexed_vertex_buffer->item(id);
+					index++;
+				}
+			}
+		}
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto indexed_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> indexed_rasterizer;
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.set_render_target(render_target);
+		indexed_rasterizer.set_vertex_buffer(indexed_vertex_buffer);
+		indexed_rasterizer.set_index_buffer(index_buffer);
+		indexed_rasterizer.set_render_target(indexed_render_target);
+
+		size_t vertex_shader_calls = 0;
+		for (auto* current : { &rasterizer, &indexed_rasterizer })
+		{
+			current->set_viewport(size, size);
+			current->vertex_shader = [&](float4 vertex, cg::vertex vertex_data) {
+				vertex_shader_calls++;
+				return std::make_pair(vertex, vertex_data);
+			};
+			current->pixel_shader = [](cg::vertex vertex_data, float depth) {
+				return cg::color{ vertex_data.diffuse_r, vertex_data.diffuse_g, depth };
+			};
+		}
+
+		WHEN("Draw with and without indices")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			indexed_rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			vertex_shader_calls = 0;
+			indexed_rasterizer.draw_indexed(index_buffer->get_number_of_elements(), 0);
+
+			THEN("Vertex shader runs once per unique vertex")
+			{
+				REQUIRE(vertex_shader_calls == indexed_vertex_buffer->get_number_of_elements());
+			}
+
+			THEN("Images are equal")
+			{
+				for (size_t i = 0; i < render_target->get_number_of_elements(); i++)
+				{
+					REQUIRE(render_target->item(i).r == indexed_render_target->item(i).r);
+					REQUIRE(render_target->item(i).g == indexed_render_target->item(i).g);
+					REQUIRE(render_target->item(i).b == indexed_render_target->item(i).b);
+				}
+			}
+		}
+
+		WHEN("Draws read past their buffers")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			indexed_rasterizer.clear_render_target({ 0, 0, 0 });
+
+			THEN("Their setup throws")
+			{
+				REQUIRE_THROWS(rasterizer.draw(vertex_buffer->get_number_of_elements(), 3));
+				REQUIRE_THROWS(
+					indexed_rasterizer.draw_indexed(index_buffer->get_number_of_elements(), 3));
+				index_buffer->item(0) =
+					static_cast<uint32_t>(indexed_vertex_buffer->get_number_of_elements());
+				REQUIRE_THROWS(indexed_rasterizer.draw_indexed(3, 0));
+			}
+		}
+	}
+}
@@ -3,7 +3,10 @@
 #include "resource.h"
 #include "world/model.h"
 
+#include <algorithm>
+#include <array>
 #include <catch.hpp>
+#include <set>
 
 
 SCENARIO("Loader produces correct vertex buffer resource")
@@ -46,3 +49,195 @@ SCENARIO("Loader produces correct vertex buffer resource")
 		}
 	}
 }
+
+SCENARIO("Loader produces indexed vertex buffer")
+{
+	GIVEN("An Obj file with 2 triangles")
+	{
+		std::filesystem::path obj_file("models/z_test.obj");
+
+		WHEN("Loader load the file")
+		{
+			cg::world::model model;
+			model.load_obj(std::filesystem::absolute(obj_file));
+
+			THEN("Indexed vertices reproduce the flat vertex buffer")
+			{
+				auto vertex_buffer = model.get_vertex_buffer();
+				auto indexed_vertex_buffer = model.get_indexed_vertex_buffer();
+				auto index_buffer = model.get_index_buffer();
+
+				REQUIRE(
+					index_buffer->get_number_of_elements() ==
+					vertex_buffer->get_number_of_elements());
+				REQUIRE(
+					indexed_vertex_buffer->get_number_of_elements() <=
+					vertex_buffer->get_number_of_elements());
+
+				for (size_t i = 0; i < index_buffer->get_number_of_elements(); i++)
+				{
+					const cg::vertex& expected = vertex_buffer->item(i);
+					const cg::vertex& actual =
+						indexed_vertex_buffer->item(index_buffer->item(i));
+					REQUIRE(expected.x == actual.x);
+					REQUIRE(expected.y == actual.y);
+					REQUIRE(expected.z == actual.z);
+					REQUIRE(expected.nx == actual.nx);
+					REQUIRE(expected.diffuse_r == actual.diffuse_r);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("Loader computes per-shape bounds")
+{
+	GIVEN("An Obj file with 2 shapes")
+	{
+		std::filesystem::path obj_file("models/z_test.obj");
+
+		WHEN("Loader load the file")
+		{
+			cg::world::model model;
+			model.load_obj(std::filesystem::absolute(obj_file));
+
+			THEN("Shapes cover the index buffer and bound their vertices")
+			{
+				auto vertex_buffer = model.get_vertex_buffer();
+				auto bounds = model.get_per_shape_bounds();
+				REQUIRE(bounds.size() == 2);
+
+				size_t index_offset = 0;
+				for (const auto& shape : bounds)
+				{
+					REQUIRE(shape.index_offset == index_offset);
+					REQUIRE(shape.num_indexes == 3);
+					index_offset += shape.num_indexes;
+
+					REQUIRE(shape.aabb_min.x == -0.5f);
+					REQUIRE(shape.aabb_min.y == -0.5f);
+					REQUIRE(shape.aabb_min.z == -0.5f);
+					REQUIRE(shape.aabb_max.x == 0.5f);
+					REQUIRE(shape.aabb_max.y == 0.5f);
+					REQUIRE(shape.aabb_max.z == 0.5f);
+
+					for (size_t i = shape.index_offset;
+						 i < shape.index_offset + shape.num_indexes; i++)
+					{
+						const cg::vertex& vertex = vertex_buffer->item(i);
+						float3 position{ vertex.x, vertex.y, vertex.z };
+						REQUIRE(
+							length(position - shape.sphere_center) <=
+							shape.sphere_radius + FLT_EPSILON);
+					}
+				}
+				REQUIRE(index_offset == vertex_buffer->get_number_of_elements());
+			}
+		}
+	}
+}
+
+SCENARIO("Loader produces compact vertex buffer and material table")
+{
+	GIVEN("An Obj file with 2 triangles")
+	{
+		std::filesystem::path obj_file("models/z_test.obj");
+
+		WHEN("Loader load the file")
+		{
+			cg::world::model model;
+			model.load_obj(std::filesystem::absolute(obj_file));
+
+			THEN("Compact vertices reproduce the indexed vertex buffer")
+			{
+				auto indexed_vertex_buffer = model.get_indexed_vertex_buffer();
+				auto compact_vertex_buffer = model.get_compact_vertex_buffer();
+				auto materials = model.get_materials();
+
+				REQUIRE(
+					compact_vertex_buffer->get_number_of_elements() ==
+					indexed_vertex_buffer->get_number_of_elements());
+				REQUIRE(
+					2 * compact_vertex_buffer->get_size_in_bytes() <
+					indexed_vertex_buffer->get_size_in_bytes());
+
+				for (size_t i = 0; i < indexed_vertex_buffer->get_number_of_elements(); i++)
+				{
+					const cg::vertex& expected = indexed_vertex_buffer->item(i);
+					const cg::compact_vertex& actual = compact_vertex_buffer->item(i);
+					REQUIRE(expected.x == actual.x);
+					REQUIRE(expected.y == actual.y);
+					REQUIRE(expected.z == actual.z);
+
+					float3 normal = cg::vertex_layout<cg::compact_vertex>::get_normal(actual);
+					// Within the quantization error of the snorm coordinates
+					REQUIRE(std::abs(expected.nx - normal.x) < 1.e-4f);
+					REQUIRE(std::abs(expected.ny - normal.y) < 1.e-4f);
+					REQUIRE(std::abs(expected.nz - normal.z) < 1.e-4f);
+
+					REQUIRE(actual.material_id < materials->size());
+					const cg::material& material = (*materials)[actual.material_id];
+					REQUIRE(expected.ambient_r == material.ambient.x);
+					REQUIRE(expected.diffuse_r == material.diffuse.x);
+					REQUIRE(expected.diffuse_g == material.diffuse.y);
+					REQUIRE(expected.emissive_b == material.emissive.z);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("Loader converts shapes to triangle strips")
+{
+	GIVEN("An Obj file of a cube")
+	{
+		std::filesystem::path obj_file("models/cube.obj");
+
+		WHEN("Loader load the file and builds strips")
+		{
+			cg::world::model model;
+			model.load_obj(std::filesystem::absolute(obj_file));
+			model.stripify();
+
+			THEN("Strips of every shape have the triangles of the shape with their winding")
+			{
+				auto index_buffer = model.get_index_buffer();
+				auto strip_index_buffer = model.get_strip_index_buffer();
+
+				// Triangles rotated to start with the smallest index
+				auto get_triangle = [](uint32_t a, uint32_t b, uint32_t c) {
+					std::array<uint32_t, 3> triangle{ a, b, c };
+					while (triangle[0] != std::min({ a, b, c }))
+						std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+					return triangle;
+				};
+
+				for (const auto& shape : model.get_per_shape_bounds())
+				{
+					std::multiset<std::array<uint32_t, 3>> expected, result;
+					for (size_t i = 0; i < shape.num_indexes; i += 3)
+					{
+						size_t id = shape.index_offset + i;
+						expected.insert(get_triangle(
+							index_buffer->item(id), index_buffer->item(id + 1),
+							index_buffer->item(id + 2)));
+					}
+
+					for (size_t i = 0; i + 2 < shape.num_strip_indexes; i++)
+					{
+						size_t id = shape.strip_index_offset + i;
+						uint32_t a = strip_index_buffer->item(id);
+						uint32_t b = strip_index_buffer->item(id + 1);
+						uint32_t c = strip_index_buffer->item(id + 2);
+						if (i % 2 == 1)
+							std::swap(a, b);
+						if (a != b && b != c && a != c)
+							result.insert(get_triangle(a, b, c));
+					}
+
+					REQUIRE(result == expected);
+				}
+			}
+		}
+	}
+}
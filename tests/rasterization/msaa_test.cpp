@@ -0,0 +1,218 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cfloat>
+
+
+SCENARIO("Rasterizer resolves multisampled coverage")
+{
+	GIVEN("Render targets, multisampled depth buffers, and rasterizers")
+	{
+		const size_t size = 32;
+		const unsigned sample_counts[3] = { 2, 4, 8 };
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+
+		struct target
+		{
+			std::shared_ptr<cg::resource<cg::unsigned_color>> render_target;
+			std::shared_ptr<cg::resource<float>> depth_buffer;
+			size_t shaded_fragments;
+		};
+
+		auto draw = [&](unsigned samples, size_t num_vertexes) {
+			target result;
+			result.render_target =
+				std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+			result.depth_buffer = std::make_shared<cg::resource<float>>(size * samples, size);
+
+			cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+			rasterizer.sample_count = samples;
+			rasterizer.set_render_target(result.render_target, result.depth_buffer);
+			rasterizer.set_viewport(size, size);
+			rasterizer.set_vertex_buffer(vertex_buffer);
+			rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+				return std::make_pair(vertex, vertex_data);
+			};
+			rasterizer.pixel_shader = [](cg::vertex vertex_data, float depth) {
+				return cg::color{ 1.f, 1.f, 1.f };
+			};
+
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(num_vertexes, 0);
+			rasterizer.resolve();
+			result.shaded_fragments = rasterizer.get_statistics().shaded_fragments;
+			return result;
+		};
+
+		WHEN("Draw a triangle with a slanted edge")
+		{
+			vertex_buffer->item(0) = { -1.f, -1.f, 0.5f };
+			vertex_buffer->item(1) = { 0.9f, -1.f, 0.5f };
+			vertex_buffer->item(2) = { -1.f, 0.7f, 0.5f };
+
+			THEN("Pixels are shaded once and average their covered samples")
+			{
+				for (unsigned samples : sample_counts)
+				{
+					target result = draw(samples, 3);
+
+					size_t covered_pixels = 0;
+					size_t partial_pixels = 0;
+					for (size_t y = 0; y < size; y++)
+					{
+						for (size_t x = 0; x < size; x++)
+						{
+							unsigned covered = 0;
+							for (size_t s = 0; s < samples; s++)
+							{
+								float depth = result.depth_buffer->item(x * samples + s, y);
+								REQUIRE((depth == 0.5f || depth == FLT_MAX));
+								covered += depth == 0.5f;
+							}
+
+							unsigned expected = (covered * 255 + samples / 2) / samples;
+							REQUIRE(result.render_target->item(x, y).r == expected);
+							covered_pixels += covered > 0;
+							partial_pixels += covered > 0 && covered < samples;
+						}
+					}
+					REQUIRE(covered_pixels == result.shaded_fragments);
+					REQUIRE(partial_pixels > 0);
+				}
+			}
+		}
+
+		WHEN("Draw a quad of two triangles")
+		{
+			vertex_buffer->item(0) = { -0.6f, -0.6f, 0.5f };
+			vertex_buffer->item(1) = { 0.6f, -0.6f, 0.5f };
+			vertex_buffer->item(2) = { 0.6f, 0.6f, 0.5f };
+			vertex_buffer->item(3) = { -0.6f, -0.6f, 0.5f };
+			vertex_buffer->item(4) = { 0.6f, 0.6f, 0.5f };
+			vertex_buffer->item(5) = { -0.6f, 0.6f, 0.5f };
+
+			THEN("Samples on the shared edge are covered once and there is no seam")
+			{
+				for (unsigned samples : sample_counts)
+				{
+					target result = draw(samples, 6);
+
+					// The quad spans pixels 6.4 - 25.6
+					for (size_t y = 7; y <= 25; y++)
+					{
+						for (size_t x = 7; x <= 25; x++)
+						{
+							REQUIRE(result.render_target->item(x, y).r == 255);
+						}
+					}
+					REQUIRE(result.render_target->item(5, 16).r == 0);
+					REQUIRE(result.render_target->item(27, 16).r == 0);
+				}
+			}
+		}
+	}
+
+	GIVEN("Random overlapping triangles and 4x multisampled rasterizers")
+	{
+		const size_t width = 48;
+		const size_t height = 32;
+		const size_t num_triangles = 200;
+		const unsigned samples = 4;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 5);
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		rasterizer_type rasterizers[4];
+		std::shared_ptr<cg::resource<cg::unsigned_color>> render_targets[4];
+
+		// Reference, depth pre-pass, visibility buffer, and tiled rasterization
+		rasterizers[1].depth_prepass = true;
+		rasterizers[2].visibility_buffer = true;
+		rasterizers[3].tiled_rasterization = true;
+		rasterizers[3].tile_size = 16;
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			render_targets[i] =
+				std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+			auto depth_buffer = std::make_shared<cg::resource<float>>(width * samples, height);
+			rasterizers[i].sample_count = samples;
+			rasterizers[i].set_render_target(render_targets[i], depth_buffer);
+			random_scene::bind(rasterizers[i], vertex_buffer, width, height);
+		}
+
+		WHEN("Draw the triangles in every mode")
+		{
+			for (size_t i = 0; i < 4; i++)
+			{
+				rasterizers[i].clear_render_target({ 0, 0, 0 }, 1.f);
+				rasterizers[i].draw(num_triangles * 3, 0);
+				rasterizers[i].resolve();
+			}
+
+			THEN("Resolved images are the same")
+			{
+				for (size_t i = 1; i < 4; i++)
+				{
+					random_scene::require_equal(
+						*render_targets[0], *render_targets[i], width, height);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("Samples are resolved once after all of the draws")
+{
+	GIVEN("A 4x multisampled rasterizer and a quad of two triangles")
+	{
+		const size_t size = 32;
+		const unsigned samples = 4;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+		vertex_buffer->item(0) = { -0.6f, -0.6f, 0.5f };
+		vertex_buffer->item(1) = { 0.6f, -0.6f, 0.5f };
+		vertex_buffer->item(2) = { 0.6f, 0.6f, 0.5f };
+		vertex_buffer->item(3) = { -0.6f, -0.6f, 0.5f };
+		vertex_buffer->item(4) = { 0.6f, 0.6f, 0.5f };
+		vertex_buffer->item(5) = { -0.6f, 0.6f, 0.5f };
+
+		auto render_target = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.sample_count = samples;
+		rasterizer.set_render_target(
+			render_target, std::make_shared<cg::resource<float>>(size * samples, size));
+		rasterizer.set_viewport(size, size);
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [](cg::vertex vertex_data, float depth) {
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		WHEN("The triangles are drawn by separate draw calls")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 0);
+			rasterizer.draw(3, 3);
+
+			THEN("The render target is written only by resolve")
+			{
+				REQUIRE(render_target->item(size / 2, size / 2).r == 0);
+
+				rasterizer.resolve();
+				for (size_t y = 7; y <= 25; y++)
+				{
+					for (size_t x = 7; x <= 25; x++)
+						REQUIRE(render_target->item(x, y).r == 255);
+				}
+				REQUIRE(render_target->item(5, 16).r == 0);
+			}
+		}
+	}
+}
@@ -0,0 +1,214 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cfloat>
+
+
+namespace
+{
+// Screen-aligned quad at a constant depth
+void set_quad(cg::resource<cg::vertex>& buffer, size_t offset, float extent, float z)
+{
+	buffer.item(offset + 0) = { -extent, -extent, z };
+	buffer.item(offset + 1) = { extent, -extent, z };
+	buffer.item(offset + 2) = { extent, extent, z };
+	buffer.item(offset + 3) = { -extent, -extent, z };
+	buffer.item(offset + 4) = { extent, extent, z };
+	buffer.item(offset + 5) = { -extent, extent, z };
+}
+} // namespace
+
+SCENARIO("Occlusion queries count visible samples and predicate draws")
+{
+	GIVEN("A small quad, a near full-screen quad, and a rasterizer with a depth buffer")
+	{
+		const size_t size = 32;
+		// The small quad covers pixels 8 - 23
+		const size_t quad_pixels = 16 * 16;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(12);
+		set_quad(*vertex_buffer, 0, 0.5f, 0.8f);
+		set_quad(*vertex_buffer, 6, 1.f, 0.2f);
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		auto render_target = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto depth_buffer = std::make_shared<cg::resource<float>>(size, size);
+
+		rasterizer_type rasterizer;
+		rasterizer.set_render_target(render_target, depth_buffer);
+		rasterizer.set_viewport(size, size);
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+		rasterizer.clear_render_target({ 0, 0, 0 });
+
+		WHEN("The small quad is drawn inside of a query in every mode")
+		{
+			THEN("The query counts its samples")
+			{
+				for (size_t mode = 0; mode < 5; mode++)
+				{
+					rasterizer_type query_rasterizer;
+					query_rasterizer.tiled_rasterization = mode == 1;
+					query_rasterizer.tile_size = 16;
+					query_rasterizer.depth_prepass = mode == 2;
+					query_rasterizer.visibility_buffer = mode == 3;
+					query_rasterizer.sample_count = mode == 4 ? 4 : 1;
+
+					const size_t samples = query_rasterizer.sample_count;
+					query_rasterizer.set_render_target(
+						std::make_shared<cg::resource<cg::unsigned_color>>(size, size),
+						std::make_shared<cg::resource<float>>(size * samples, size));
+					query_rasterizer.set_viewport(size, size);
+					query_rasterizer.set_vertex_buffer(vertex_buffer);
+					query_rasterizer.vertex_shader = rasterizer.vertex_shader;
+					query_rasterizer.pixel_shader = rasterizer.pixel_shader;
+					query_rasterizer.clear_render_target({ 0, 0, 0 });
+
+					query_rasterizer.begin_query(0);
+					query_rasterizer.draw(6, 0);
+					query_rasterizer.end_query();
+					REQUIRE(query_rasterizer.get_query_result(0) == quad_pixels * samples);
+				}
+			}
+		}
+
+		WHEN("The small quad is queried behind the near quad and drawn with the predicate")
+		{
+			rasterizer.draw(6, 6);
+			rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 1.f, 0.f, 0.f };
+			};
+
+			rasterizer.begin_query(0);
+			rasterizer.draw(6, 0);
+			rasterizer.end_query();
+			rasterizer.set_predicate(0);
+			rasterizer.draw(6, 0);
+
+			THEN("Nothing passes and the predicated draw is skipped")
+			{
+				REQUIRE(rasterizer.get_query_result(0) == 0);
+				REQUIRE(rasterizer.get_statistics().skipped_draws == 1);
+				REQUIRE(rasterizer.get_statistics().shaded_fragments == 0);
+				REQUIRE(render_target->item(size / 2, size / 2).g == 255);
+			}
+
+			THEN("Draws run again after the predicate is unset")
+			{
+				rasterizer.set_predicate(cg::renderer::no_query);
+				rasterizer.clear_render_target({ 0, 0, 0 });
+				rasterizer.draw(6, 0);
+				REQUIRE(rasterizer.get_statistics().skipped_draws == 0);
+				REQUIRE(render_target->item(size / 2, size / 2).r == 255);
+				REQUIRE(render_target->item(size / 2, size / 2).g == 0);
+			}
+		}
+
+		WHEN("The small quad is drawn as a proxy without writes")
+		{
+			rasterizer.color_write = false;
+			rasterizer.depth_write = false;
+			rasterizer.begin_query(3);
+			rasterizer.draw(6, 0);
+			rasterizer.end_query();
+
+			THEN("Samples are counted, but neither color nor depth is written")
+			{
+				REQUIRE(rasterizer.get_query_result(3) == quad_pixels);
+				REQUIRE(rasterizer.get_statistics().shaded_fragments == 0);
+				for (size_t p = 0; p < render_target->get_number_of_elements(); p++)
+				{
+					REQUIRE(render_target->item(p).r == 0);
+					REQUIRE(depth_buffer->item(p) == FLT_MAX);
+				}
+			}
+		}
+
+		WHEN("A command list records proxies and predicated draws before their occluder")
+		{
+			// The near small quad covers pixels 12 - 19
+			auto list_buffer = std::make_shared<cg::resource<cg::vertex>>(18);
+			for (size_t i = 0; i < 12; i++)
+				list_buffer->item(i) = vertex_buffer->item(i);
+			set_quad(*list_buffer, 12, 0.25f, 0.1f);
+
+			cg::renderer::command_list<cg::vertex> commands(
+				rasterizer.vertex_shader, [](cg::vertex vertex_data, float z) {
+					return cg::color{ 1.f, 0.f, 0.f };
+				});
+			commands.set_vertex_buffer(list_buffer);
+
+			// Query 0 is behind the occluder, query 1 in front of it
+			const size_t offsets[2] = { 0, 12 };
+			for (size_t query = 0; query < 2; query++)
+			{
+				commands.begin_query(query);
+				commands.color_write = false;
+				commands.depth_write = false;
+				commands.draw(6, offsets[query]);
+				commands.end_query();
+
+				commands.set_predicate(query);
+				commands.color_write = true;
+				commands.depth_write = true;
+				commands.draw(6, offsets[query]);
+				commands.set_predicate(cg::renderer::no_query);
+			}
+			commands.pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ 0.f, 1.f, 0.f };
+			};
+			commands.draw(6, 6);
+			rasterizer.execute(commands);
+
+			THEN("Draws run front-to-back and only the hidden one is skipped")
+			{
+				REQUIRE(rasterizer.get_query_result(0) == 0);
+				REQUIRE(rasterizer.get_query_result(1) == 8 * 8);
+				REQUIRE(rasterizer.get_statistics().skipped_draws == 1);
+				REQUIRE(rasterizer.get_statistics().shaded_fragments == size * size);
+				REQUIRE(render_target->item(size / 2, size / 2).r == 255);
+				REQUIRE(render_target->item(size / 2, size / 2).g == 0);
+				REQUIRE(render_target->item(9, 9).g == 255);
+				REQUIRE(render_target->item(9, 9).r == 0);
+			}
+		}
+
+		WHEN("A predicated draw is recorded before the draw of its query")
+		{
+			auto list_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+			set_quad(*list_buffer, 0, 0.25f, 0.1f);
+
+			cg::renderer::command_list<cg::vertex> commands(
+				rasterizer.vertex_shader, [](cg::vertex vertex_data, float z) {
+					return cg::color{ 1.f, 0.f, 0.f };
+				});
+			commands.set_vertex_buffer(list_buffer);
+
+			commands.set_predicate(0);
+			commands.draw(6, 0);
+			commands.set_predicate(cg::renderer::no_query);
+
+			commands.begin_query(0);
+			commands.color_write = false;
+			commands.depth_write = false;
+			commands.draw(6, 0);
+			commands.end_query();
+			rasterizer.execute(commands);
+
+			THEN("The query is counted before the draw at the same depth")
+			{
+				REQUIRE(rasterizer.get_query_result(0) == 8 * 8);
+				REQUIRE(rasterizer.get_statistics().skipped_draws == 0);
+				REQUIRE(render_target->item(size / 2, size / 2).r == 255);
+			}
+		}
+	}
+}
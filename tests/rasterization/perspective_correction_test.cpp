@@ -0,0 +1,121 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+// Writes the interpolated attributes of every shaded pixel
+struct capturing_pixel_shader
+{
+	using attributes = cg::attribute_list<&cg::vertex::diffuse_r>;
+
+	cg::color operator()(const cg::vertex& vertex_data, const float z) const
+	{
+		size_t x = static_cast<size_t>(vertex_data.x);
+		size_t y = static_cast<size_t>(vertex_data.y);
+		diffuse->item(x, y) = vertex_data.diffuse_r;
+		ambient->item(x, y) = vertex_data.ambient_r;
+		return cg::color{ 1.f, 1.f, 1.f };
+	}
+
+	std::shared_ptr<cg::resource<float>> diffuse;
+	std::shared_ptr<cg::resource<float>> ambient;
+};
+
+SCENARIO("Rasterizer interpolates attributes in a perspective-correct way")
+{
+	GIVEN("Quad on the plane w = 1 + x, and rasterizer with a capturing pixel shader")
+	{
+		const size_t width = 64;
+		const size_t height = 8;
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto diffuse = std::make_shared<cg::resource<float>>(width, height);
+		auto ambient = std::make_shared<cg::resource<float>>(width, height);
+
+		// w comes from the z coordinate, diffuse_r is linear in x
+		auto vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+			return std::make_pair(
+				float4{ vertex.x, vertex.y, 0.5f * vertex.z, vertex.z }, vertex_data);
+		};
+		using vertex_shader_type = decltype(vertex_shader);
+		cg::renderer::rasterizer<
+			cg::vertex, cg::unsigned_color, vertex_shader_type, capturing_pixel_shader>
+			rasterizer(vertex_shader, capturing_pixel_shader{ diffuse, ambient });
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(width, height);
+		rasterizer.face_culling = decltype(rasterizer)::cull_mode::none;
+
+		const float xs[2] = { -0.5f, 2.f };
+		cg::vertex corners[2][2];
+		for (size_t i = 0; i < 2; i++)
+		{
+			for (size_t j = 0; j < 2; j++)
+			{
+				float w = 1.f + xs[i];
+				cg::vertex& corner = corners[i][j];
+				corner = cg::vertex{};
+				corner.x = xs[i];
+				corner.y = (j == 0 ? -1.f : 1.f) * w;
+				corner.z = w;
+				corner.diffuse_r = (xs[i] + 0.5f) / 2.5f;
+				corner.ambient_r = 1.f;
+			}
+		}
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(6);
+		vertex_buffer->item(0) = corners[0][0];
+		vertex_buffer->item(1) = corners[1][0];
+		vertex_buffer->item(2) = corners[1][1];
+		vertex_buffer->item(3) = corners[0][0];
+		vertex_buffer->item(4) = corners[1][1];
+		vertex_buffer->item(5) = corners[0][1];
+		rasterizer.set_vertex_buffer(vertex_buffer);
+
+		for (size_t i = 0; i < diffuse->get_number_of_elements(); i++)
+		{
+			diffuse->item(i) = -1.f;
+			ambient->item(i) = -1.f;
+		}
+
+		WHEN("Draw the quad")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(6, 0);
+
+			THEN("Attributes match the surface point of every pixel")
+			{
+				size_t shaded_pixels = 0;
+				for (size_t y = 0; y < height; y++)
+				{
+					for (size_t x = 0; x < width; x++)
+					{
+						if (diffuse->item(x, y) < 0.f)
+							continue;
+
+						// x / w = ndc_x and w = 1 + x give x = ndc_x / (1 - ndc_x)
+						float ndc_x = 2.f * x / width - 1.f;
+						float surface_x = ndc_x / (1.f - ndc_x);
+						float expected = (surface_x + 0.5f) / 2.5f;
+						REQUIRE(std::abs(diffuse->item(x, y) - expected) < 0.01f);
+						shaded_pixels++;
+					}
+				}
+				REQUIRE(shaded_pixels == rasterizer.get_statistics().shaded_fragments);
+				REQUIRE(shaded_pixels > 0);
+			}
+
+			THEN("Attributes which the pixel shader does not read are not interpolated")
+			{
+				for (size_t i = 0; i < ambient->get_number_of_elements(); i++)
+				{
+					if (diffuse->item(i) >= 0.f)
+						REQUIRE(ambient->item(i) == 0.f);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cmath>
+
+
+SCENARIO("Rasterizer assembles triangle strips and fans")
+{
+	GIVEN("Render targets and rasterizers with back-face culling")
+	{
+		const size_t size = 64;
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		rasterizer_type rasterizers[2];
+		std::shared_ptr<cg::resource<cg::unsigned_color>> render_targets[2];
+
+		for (size_t i = 0; i < 2; i++)
+		{
+			render_targets[i] = std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+			rasterizers[i].set_render_target(render_targets[i]);
+			rasterizers[i].set_viewport(size, size);
+			rasterizers[i].vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+				return std::make_pair(vertex, vertex_data);
+			};
+			rasterizers[i].pixel_shader = [](cg::vertex vertex_data, float z) {
+				return cg::color{ vertex_data.diffuse_r, vertex_data.diffuse_g, 1.f };
+			};
+			rasterizers[i].clear_render_target({ 0, 0, 0 });
+		}
+
+		auto compare = [&]() {
+			for (size_t p = 0; p < render_targets[0]->get_number_of_elements(); p++)
+			{
+				REQUIRE(render_targets[1]->item(p).r == render_targets[0]->item(p).r);
+				REQUIRE(render_targets[1]->item(p).g == render_targets[0]->item(p).g);
+				REQUIRE(render_targets[1]->item(p).b == render_targets[0]->item(p).b);
+			}
+		};
+
+		WHEN("Draw a strip of quads and the same triangles as a list")
+		{
+			// Counter-clockwise strip along x: top and bottom vertices alternate
+			const size_t num_columns = 6;
+			auto strip = std::make_shared<cg::resource<cg::vertex>>(2 * num_columns);
+			for (size_t i = 0; i < num_columns; i++)
+			{
+				float x = -0.9f + 1.8f * i / (num_columns - 1);
+				strip->item(2 * i) = { x, 0.7f + 0.1f * (i % 2), 0.5f };
+				strip->item(2 * i + 1) = { x, -0.7f, 0.5f };
+				strip->item(2 * i).diffuse_r = static_cast<float>(i) / num_columns;
+				strip->item(2 * i + 1).diffuse_g = static_cast<float>(i) / num_columns;
+			}
+
+			const size_t num_triangles = strip->get_number_of_elements() - 2;
+			auto list = std::make_shared<cg::resource<cg::vertex>>(num_triangles * 3);
+			for (size_t t = 0; t < num_triangles; t++)
+			{
+				bool odd = t % 2 == 1;
+				list->item(3 * t) = strip->item(odd ? t + 1 : t);
+				list->item(3 * t + 1) = strip->item(odd ? t : t + 1);
+				list->item(3 * t + 2) = strip->item(t + 2);
+			}
+
+			rasterizers[0].set_vertex_buffer(list);
+			rasterizers[0].draw(list->get_number_of_elements(), 0);
+
+			rasterizers[1].set_vertex_buffer(strip);
+			rasterizers[1].topology = cg::renderer::primitive_topology::triangle_strip;
+			rasterizers[1].draw(strip->get_number_of_elements(), 0);
+
+			THEN("Every triangle of the strip keeps the winding and is drawn")
+			{
+				compare();
+				REQUIRE(rasterizers[1].get_statistics().submitted_triangles == num_triangles);
+				REQUIRE(rasterizers[1].get_statistics().culled_triangles == 0);
+				REQUIRE(render_targets[1]->item(size / 2, size / 2).b == 255);
+			}
+		}
+
+		WHEN("Draw an indexed fan of a polygon and the same triangles as a list")
+		{
+			const size_t num_corners = 7;
+			auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(num_corners + 1);
+			for (size_t i = 0; i < num_corners; i++)
+			{
+				float angle = 6.2831853f * i / num_corners;
+				vertex_buffer->item(i + 1) = { 0.8f * std::cos(angle), 0.8f * std::sin(angle), 0.5f };
+				vertex_buffer->item(i + 1).diffuse_r = static_cast<float>(i) / num_corners;
+			}
+
+			// The fan starts at the first index of the draw
+			auto fan_indices = std::make_shared<cg::resource<uint32_t>>(num_corners + 2);
+			fan_indices->item(0) = 0;
+			fan_indices->item(1) = 1;
+			for (size_t i = 0; i < num_corners; i++)
+				fan_indices->item(i + 2) = static_cast<uint32_t>(i + 1);
+
+			const size_t num_triangles = num_corners - 2;
+			auto list_indices = std::make_shared<cg::resource<uint32_t>>(num_triangles * 3);
+			for (size_t t = 0; t < num_triangles; t++)
+			{
+				list_indices->item(3 * t) = 1;
+				list_indices->item(3 * t + 1) = static_cast<uint32_t>(t + 2);
+				list_indices->item(3 * t + 2) = static_cast<uint32_t>(t + 3);
+			}
+
+			for (size_t i = 0; i < 2; i++)
+				rasterizers[i].set_vertex_buffer(vertex_buffer);
+
+			rasterizers[0].set_index_buffer(list_indices);
+			rasterizers[0].draw_indexed(num_triangles * 3, 0);
+
+			rasterizers[1].set_index_buffer(fan_indices);
+			rasterizers[1].topology = cg::renderer::primitive_topology::triangle_fan;
+			rasterizers[1].draw_indexed(num_corners, 2);
+
+			THEN("Triangles share the first vertex of the draw")
+			{
+				compare();
+				REQUIRE(rasterizers[1].get_statistics().submitted_triangles == num_triangles);
+				REQUIRE(render_targets[1]->item(size / 2, size / 2).b == 255);
+			}
+		}
+	}
+}
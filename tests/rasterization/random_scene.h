@@ -0,0 +1,77 @@
+#pragma once
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <random>
+
+
+// Scene of the tests which compare a mode of the rasterizer with the
+// reference one: random overlapping triangles across the viewport borders
+namespace random_scene
+{
+// Depths and colors are in [0, 1]
+inline std::shared_ptr<cg::resource<cg::vertex>> make_triangles(
+	size_t num_triangles, unsigned seed)
+{
+	std::default_random_engine generator(seed);
+	std::uniform_real_distribution<float> position(-1.2f, 1.2f);
+	std::uniform_real_distribution<float> value(0.f, 1.f);
+
+	auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(num_triangles * 3);
+	for (size_t i = 0; i < vertex_buffer->get_number_of_elements(); i++)
+	{
+		cg::vertex& vertex = vertex_buffer->item(i);
+		vertex.x = position(generator);
+		vertex.y = position(generator);
+		vertex.z = value(generator);
+		vertex.diffuse_r = value(generator);
+		vertex.diffuse_g = value(generator);
+		vertex.diffuse_b = value(generator);
+	}
+	return vertex_buffer;
+}
+
+// Vertices are passed through, pixels show the interpolated colors and
+// the depth
+template<typename RT>
+void bind(
+	cg::renderer::rasterizer<cg::vertex, RT>& rasterizer,
+	std::shared_ptr<cg::resource<cg::vertex>> vertex_buffer, size_t width, size_t height)
+{
+	rasterizer.set_vertex_buffer(vertex_buffer);
+	rasterizer.set_viewport(width, height);
+	rasterizer.vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+		return std::make_pair(vertex, vertex_data);
+	};
+	rasterizer.pixel_shader = [](cg::vertex vertex_data, float z) {
+		return cg::color{ vertex_data.diffuse_r, z, vertex_data.diffuse_b };
+	};
+}
+
+inline void require_equal_item(
+	const cg::unsigned_color& expected, const cg::unsigned_color& result)
+{
+	REQUIRE(result.r == expected.r);
+	REQUIRE(result.g == expected.g);
+	REQUIRE(result.b == expected.b);
+}
+
+inline void require_equal_item(float expected, float result)
+{
+	REQUIRE(result == expected);
+}
+
+// Items of tiled resources are compared by their coordinates
+template<typename T>
+void require_equal(
+	cg::resource<T>& expected, cg::resource<T>& result, size_t width, size_t height)
+{
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+			require_equal_item(expected.item(x, y), result.item(x, y));
+	}
+}
+} // namespace random_scene
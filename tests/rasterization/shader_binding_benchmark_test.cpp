@@ -0,0 +1,99 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+struct passthrough_vertex_shader
+{
+	std::pair<float4, cg::vertex> operator()(float4 vertex, cg::vertex vertex_data) const
+	{
+		return std::make_pair(vertex, vertex_data);
+	}
+};
+
+struct diffuse_pixel_shader
+{
+	cg::color operator()(const cg::vertex& vertex_data, const float z) const
+	{
+		return cg::color{ vertex_data.diffuse_r, vertex_data.diffuse_g, z };
+	}
+};
+
+SCENARIO("Shaders bound at compile time match std::function shaders")
+{
+	GIVEN("Triangle fan, render targets, and rasterizers with both shader bindings")
+	{
+		const size_t size = 256;
+		const size_t triangles = 64;
+
+		auto vertex_buffer = std::make_shared<cg::resource<cg::vertex>>(triangles * 3);
+		for (size_t i = 0; i < triangles; i++)
+		{
+			float begin = 6.2831853f * i / triangles;
+			float end = 6.2831853f * (i + 1) / triangles;
+			cg::vertex center{}, first{}, second{};
+			center.z = 0.5f;
+			first.x = 0.9f * std::cos(begin);
+			first.y = 0.9f * std::sin(begin);
+			first.diffuse_r = 1.f;
+			second.x = 0.9f * std::cos(end);
+			second.y = 0.9f * std::sin(end);
+			second.diffuse_g = 1.f;
+			vertex_buffer->item(i * 3) = center;
+			vertex_buffer->item(i * 3 + 1) = first;
+			vertex_buffer->item(i * 3 + 2) = second;
+		}
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto bound_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		rasterizer.vertex_shader = passthrough_vertex_shader{};
+		rasterizer.pixel_shader = diffuse_pixel_shader{};
+		rasterizer.set_vertex_buffer(vertex_buffer);
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+
+		cg::renderer::rasterizer<
+			cg::vertex, cg::unsigned_color, passthrough_vertex_shader, diffuse_pixel_shader>
+			bound_rasterizer;
+		bound_rasterizer.set_vertex_buffer(vertex_buffer);
+		bound_rasterizer.set_render_target(bound_render_target);
+		bound_rasterizer.set_viewport(size, size);
+
+		WHEN("Draw with both rasterizers")
+		{
+			BENCHMARK("std::function shaders")
+			{
+				rasterizer.clear_render_target({ 0, 0, 0 });
+				rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			};
+			BENCHMARK("Functor shaders")
+			{
+				bound_rasterizer.clear_render_target({ 0, 0, 0 });
+				bound_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			};
+
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			bound_rasterizer.clear_render_target({ 0, 0, 0 });
+			bound_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Images are equal")
+			{
+				for (size_t i = 0; i < render_target->get_number_of_elements(); i++)
+				{
+					REQUIRE(render_target->item(i).r == bound_render_target->item(i).r);
+					REQUIRE(render_target->item(i).g == bound_render_target->item(i).g);
+					REQUIRE(render_target->item(i).b == bound_render_target->item(i).b);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Tiled rasterizer matches serial rasterizer")
+{
+	GIVEN("Vertex buffer with random overlapping triangles and two rasterizers")
+	{
+		const size_t width = 100;
+		const size_t height = 70;
+		const size_t num_triangles = 200;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 42);
+
+		auto serial_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto serial_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+		auto tiled_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto tiled_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> serial_rasterizer;
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> tiled_rasterizer;
+		serial_rasterizer.set_render_target(serial_render_target, serial_depth_buffer);
+		tiled_rasterizer.set_render_target(tiled_render_target, tiled_depth_buffer);
+		tiled_rasterizer.tiled_rasterization = true;
+		tiled_rasterizer.tile_size = 16;
+
+		for (auto* rasterizer : { &serial_rasterizer, &tiled_rasterizer })
+			random_scene::bind(*rasterizer, vertex_buffer, width, height);
+
+		WHEN("Clear and draw with both rasterizers")
+		{
+			serial_rasterizer.clear_render_target({ 0, 0, 0 });
+			tiled_rasterizer.clear_render_target({ 0, 0, 0 });
+			serial_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			tiled_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Images and depth buffers are equal pixel for pixel")
+			{
+				random_scene::require_equal(
+					*serial_render_target, *tiled_render_target, width, height);
+				random_scene::require_equal(
+					*serial_depth_buffer, *tiled_depth_buffer, width, height);
+			}
+		}
+	}
+}
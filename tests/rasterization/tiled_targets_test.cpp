@@ -0,0 +1,86 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Rasterizer draws into tiled render targets")
+{
+	GIVEN("Random triangles and pairs of linear and tiled targets")
+	{
+		// The size isn't a multiple of the tiles
+		const size_t width = 60;
+		const size_t height = 36;
+		const size_t num_triangles = 100;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 11);
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		const size_t tile = rasterizer_type::target_tile_size;
+
+		// Plain, tiled rasterization, 4x MSAA, fast clear, and visibility buffer
+		const size_t num_modes = 5;
+		auto configure = [&](rasterizer_type& rasterizer, size_t mode) {
+			rasterizer.tiled_rasterization = mode == 1;
+			rasterizer.tile_size = 16;
+			rasterizer.sample_count = mode == 2 ? 4 : 1;
+			rasterizer.fast_clear = mode == 3;
+			rasterizer.visibility_buffer = mode == 4;
+			random_scene::bind(rasterizer, vertex_buffer, width, height);
+		};
+
+		WHEN("The triangles are drawn in every mode")
+		{
+			THEN("Tiled targets hold the same pixels and depths")
+			{
+				for (size_t mode = 0; mode < num_modes; mode++)
+				{
+					rasterizer_type linear_rasterizer;
+					rasterizer_type tiled_rasterizer;
+					configure(linear_rasterizer, mode);
+					configure(tiled_rasterizer, mode);
+					const size_t samples = linear_rasterizer.sample_count;
+
+					auto linear_target =
+						std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+					auto linear_depth =
+						std::make_shared<cg::resource<float>>(width * samples, height);
+					auto tiled_target = std::make_shared<cg::resource<cg::unsigned_color>>(
+						width, height, tile, tile);
+					auto tiled_depth = std::make_shared<cg::resource<float>>(
+						width * samples, height, tile * samples, tile);
+
+					linear_rasterizer.set_render_target(linear_target, linear_depth);
+					tiled_rasterizer.set_render_target(tiled_target, tiled_depth);
+					for (rasterizer_type* rasterizer : { &linear_rasterizer, &tiled_rasterizer })
+					{
+						rasterizer->clear_render_target({ 0, 0, 0 }, 1.f);
+						rasterizer->draw(num_triangles * 3, 0);
+						rasterizer->resolve();
+						rasterizer->resolve_clear();
+					}
+
+					random_scene::require_equal(*linear_target, *tiled_target, width, height);
+					random_scene::require_equal(
+						*linear_depth, *tiled_depth, width * samples, height);
+				}
+			}
+		}
+
+		WHEN("Tiles of the depth buffer don't hold all of the samples of a tile")
+		{
+			rasterizer_type rasterizer;
+			configure(rasterizer, 2);
+			rasterizer.set_render_target(
+				std::make_shared<cg::resource<cg::unsigned_color>>(width, height, tile, tile),
+				std::make_shared<cg::resource<float>>(width * 4, height, tile, tile));
+
+			THEN("Drawing is rejected")
+			{
+				REQUIRE_THROWS(rasterizer.draw(num_triangles * 3, 0));
+			}
+		}
+	}
+}
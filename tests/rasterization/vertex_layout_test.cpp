@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_MAIN
+
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+#include <cstdint>
+
+
+struct textured_vertex
+{
+	float x;
+	float y;
+	float z;
+
+	float u;
+	float v;
+	uint32_t material_id;
+};
+
+template<>
+struct cg::vertex_layout<textured_vertex>
+{
+	using position =
+		attribute_list<&textured_vertex::x, &textured_vertex::y, &textured_vertex::z>;
+	using attributes = attribute_list_cat_t<
+		position, attribute_list<&textured_vertex::u, &textured_vertex::v,
+								 &textured_vertex::material_id>>;
+};
+
+SCENARIO("Interpolation is generated from the vertex layout")
+{
+	GIVEN("Three vertices with distinct attributes")
+	{
+		cg::vertex vertices[3] = {};
+		for (size_t i = 0; i < 3; i++)
+		{
+			vertices[i].x = static_cast<float>(i);
+			vertices[i].ny = 2.f * i;
+			vertices[i].diffuse_g = 3.f * i;
+			vertices[i].emissive_b = 4.f * i;
+		}
+
+		WHEN("Interpolate with barycentric coordinates")
+		{
+			cg::vertex result = cg::interpolate_bary(
+				vertices[0], vertices[1], vertices[2], 0.25f, 0.25f, 0.5f);
+
+			THEN("Every attribute is interpolated")
+			{
+				REQUIRE(result.x == 1.25f);
+				REQUIRE(result.ny == 2.5f);
+				REQUIRE(result.diffuse_g == 3.75f);
+				REQUIRE(result.emissive_b == 5.f);
+				REQUIRE(result.ambient_r == 0.f);
+			}
+		}
+	}
+
+	GIVEN("Rasterizer with a custom vertex type")
+	{
+		const size_t size = 32;
+
+		auto render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(size, size);
+		auto captured_u = std::make_shared<cg::resource<float>>(size, size);
+		auto captured_material = std::make_shared<cg::resource<uint32_t>>(size, size);
+
+		cg::renderer::rasterizer<textured_vertex, cg::unsigned_color> rasterizer;
+		rasterizer.set_render_target(render_target);
+		rasterizer.set_viewport(size, size);
+		rasterizer.vertex_shader = [](float4 vertex, textured_vertex vertex_data) {
+			return std::make_pair(vertex, vertex_data);
+		};
+		rasterizer.pixel_shader = [&](const textured_vertex& vertex_data, float z) {
+			size_t x = static_cast<size_t>(vertex_data.x);
+			size_t y = static_cast<size_t>(vertex_data.y);
+			captured_u->item(x, y) = vertex_data.u;
+			captured_material->item(x, y) = vertex_data.material_id;
+			return cg::color{ 1.f, 1.f, 1.f };
+		};
+
+		// u grows from the left to the right border of the viewport
+		auto vertex_buffer = std::make_shared<cg::resource<textured_vertex>>(3);
+		vertex_buffer->item(0) = { -1.f, -1.f, 0.5f, 0.f, 0.f, 7 };
+		vertex_buffer->item(1) = { 1.f, -1.f, 0.5f, 1.f, 0.f, 8 };
+		vertex_buffer->item(2) = { -1.f, 1.f, 0.5f, 0.f, 1.f, 9 };
+		rasterizer.set_vertex_buffer(vertex_buffer);
+
+		for (size_t i = 0; i < captured_u->get_number_of_elements(); i++)
+			captured_u->item(i) = -1.f;
+
+		WHEN("Draw a triangle")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(3, 0);
+
+			THEN("Float attributes are interpolated and the rest are taken from the first vertex")
+			{
+				size_t shaded_pixels = 0;
+				for (size_t y = 0; y < size; y++)
+				{
+					for (size_t x = 0; x < size; x++)
+					{
+						if (captured_u->item(x, y) < 0.f)
+							continue;
+
+						float expected = static_cast<float>(x) / size;
+						REQUIRE(std::abs(captured_u->item(x, y) - expected) < 1.e-4f);
+						REQUIRE(captured_material->item(x, y) == 7);
+						shaded_pixels++;
+					}
+				}
+				REQUIRE(shaded_pixels == rasterizer.get_statistics().shaded_fragments);
+				REQUIRE(shaded_pixels > 0);
+			}
+		}
+	}
+}
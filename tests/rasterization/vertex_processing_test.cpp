@@ -0,0 +1,191 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <atomic>
+#include <catch.hpp>
+#include <memory_resource>
+#include <random>
+
+
+// Exposes the projection of the vertex stage
+class projecting_rasterizer : public cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>
+{
+	using base = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+
+public:
+	using base::project_positions;
+	using base::vertex_positions;
+};
+
+// More than one chunk of the vertex stage and not a multiple of 4, so the
+// vectorized projection has a scalar tail
+const size_t num_triangles = 101;
+
+SCENARIO("Projection of vertices matches the scalar formulas")
+{
+	GIVEN("Random clip-space positions")
+	{
+		const size_t width = 100;
+		const size_t height = 70;
+		const size_t num_vertexes = num_triangles * 3;
+
+		projecting_rasterizer rasterizer;
+		rasterizer.set_viewport(width, height);
+
+		projecting_rasterizer::vertex_positions positions(std::pmr::get_default_resource());
+		std::default_random_engine generator(13);
+		std::uniform_real_distribution<float> coordinate(-2.f, 2.f);
+		std::uniform_real_distribution<float> w(0.1f, 2.f);
+		for (size_t i = 0; i < num_vertexes; i++)
+		{
+			positions.x.push_back(coordinate(generator));
+			positions.y.push_back(coordinate(generator));
+			positions.z.push_back(coordinate(generator));
+			positions.w.push_back(w(generator));
+		}
+		positions.screen_x.resize(num_vertexes);
+		positions.screen_y.resize(num_vertexes);
+		positions.screen_z.resize(num_vertexes);
+
+		WHEN("Ranges starting at aligned and unaligned vertices are projected")
+		{
+			THEN("Screen positions are equal to the scalar ones bit for bit")
+			{
+				for (size_t begin : { size_t(0), size_t(1), size_t(254) })
+				{
+					rasterizer.project_positions(positions, begin, num_vertexes);
+					for (size_t i = begin; i < num_vertexes; i++)
+					{
+						float x = positions.x[i] / positions.w[i];
+						float y = positions.y[i] / positions.w[i];
+						float z = positions.z[i] / positions.w[i];
+						x = (x + 1.f) * static_cast<float>(width) / 2.f;
+						y = (-y + 1.f) * static_cast<float>(height) / 2.f;
+						REQUIRE(positions.screen_x[i] == x);
+						REQUIRE(positions.screen_y[i] == y);
+						REQUIRE(positions.screen_z[i] == z);
+					}
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("Parallel vertex processing matches the serial one")
+{
+	GIVEN("Random triangles with varying w and two rasterizers")
+	{
+		const size_t width = 100;
+		const size_t height = 70;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 7);
+
+		auto serial_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto serial_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+		auto parallel_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto parallel_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> serial_rasterizer;
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> parallel_rasterizer;
+		serial_rasterizer.set_render_target(serial_render_target, serial_depth_buffer);
+		parallel_rasterizer.set_render_target(parallel_render_target, parallel_depth_buffer);
+		parallel_rasterizer.parallel_vertex_processing = true;
+
+		for (auto* rasterizer : { &serial_rasterizer, &parallel_rasterizer })
+		{
+			random_scene::bind(*rasterizer, vertex_buffer, width, height);
+			// Positions are divided by w in the projection
+			rasterizer->vertex_shader = [](float4 vertex, cg::vertex vertex_data) {
+				return std::make_pair(vertex * (1.f + vertex_data.diffuse_g), vertex_data);
+			};
+		}
+
+		WHEN("Clear and draw with both rasterizers")
+		{
+			serial_rasterizer.clear_render_target({ 0, 0, 0 });
+			parallel_rasterizer.clear_render_target({ 0, 0, 0 });
+			serial_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+			parallel_rasterizer.draw(vertex_buffer->get_number_of_elements(), 0);
+
+			THEN("Images and depth buffers are equal pixel for pixel")
+			{
+				random_scene::require_equal(
+					*serial_render_target, *parallel_render_target, width, height);
+				random_scene::require_equal(
+					*serial_depth_buffer, *parallel_depth_buffer, width, height);
+			}
+		}
+	}
+}
+
+SCENARIO("Indexed draw skips the vertices which the indices don't reference")
+{
+	GIVEN("Random triangles with an unreferenced vertex after each one")
+	{
+		const size_t width = 100;
+		const size_t height = 70;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 11);
+		const size_t num_vertexes = vertex_buffer->get_number_of_elements();
+
+		// Vertex i of the draw is at 2 * i + 5, the rest are never shaded
+		const uint32_t first_index = 5;
+		auto sparse_vertex_buffer =
+			std::make_shared<cg::resource<cg::vertex>>(2 * num_vertexes + 2 * first_index);
+		for (size_t i = 0; i < sparse_vertex_buffer->get_number_of_elements(); i++)
+		{
+			cg::vertex& vertex = sparse_vertex_buffer->item(i);
+			vertex = {};
+			vertex.x = 100.f;
+			vertex.y = 100.f;
+		}
+		auto index_buffer = std::make_shared<cg::resource<uint32_t>>(num_vertexes);
+		for (size_t i = 0; i < num_vertexes; i++)
+		{
+			uint32_t index = static_cast<uint32_t>(2 * i) + first_index;
+			index_buffer->item(i) = index;
+			sparse_vertex_buffer->item(index) = vertex_buffer->item(i);
+		}
+
+		auto render_target = std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+		auto indexed_render_target =
+			std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+		auto indexed_depth_buffer = std::make_shared<cg::resource<float>>(width, height);
+
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> rasterizer;
+		cg::renderer::rasterizer<cg::vertex, cg::unsigned_color> indexed_rasterizer;
+		rasterizer.set_render_target(render_target, depth_buffer);
+		random_scene::bind(rasterizer, vertex_buffer, width, height);
+		indexed_rasterizer.set_render_target(indexed_render_target, indexed_depth_buffer);
+		random_scene::bind(indexed_rasterizer, sparse_vertex_buffer, width, height);
+		indexed_rasterizer.set_index_buffer(index_buffer);
+		indexed_rasterizer.parallel_vertex_processing = true;
+
+		std::atomic<size_t> vertex_shader_calls = 0;
+		indexed_rasterizer.vertex_shader = [&](float4 vertex, cg::vertex vertex_data) {
+			vertex_shader_calls++;
+			return std::make_pair(vertex, vertex_data);
+		};
+
+		WHEN("Draw the triangles without indices and through the sparse indices")
+		{
+			rasterizer.clear_render_target({ 0, 0, 0 });
+			indexed_rasterizer.clear_render_target({ 0, 0, 0 });
+			rasterizer.draw(num_vertexes, 0);
+			indexed_rasterizer.draw_indexed(num_vertexes, 0);
+
+			THEN("Only the referenced vertices are shaded and the images are equal")
+			{
+				REQUIRE(vertex_shader_calls == num_vertexes);
+				random_scene::require_equal(
+					*render_target, *indexed_render_target, width, height);
+				random_scene::require_equal(
+					*depth_buffer, *indexed_depth_buffer, width, height);
+			}
+		}
+	}
+}
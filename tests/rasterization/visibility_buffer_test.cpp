@@ -0,0 +1,143 @@
+#define CATCH_CONFIG_MAIN
+
+#include "random_scene.h"
+#include "renderer/rasterizer/rasterizer.h"
+#include "resource.h"
+
+#include <catch.hpp>
+
+
+SCENARIO("Visibility buffer shades every visible pixel once")
+{
+	GIVEN("Random overlapping triangles, render targets, depth buffers, and rasterizers")
+	{
+		const size_t width = 64;
+		const size_t height = 48;
+		const size_t num_triangles = 300;
+		auto vertex_buffer = random_scene::make_triangles(num_triangles, 11);
+
+		using rasterizer_type = cg::renderer::rasterizer<cg::vertex, cg::unsigned_color>;
+		rasterizer_type rasterizers[3];
+		std::shared_ptr<cg::resource<cg::unsigned_color>> render_targets[3];
+		std::shared_ptr<cg::resource<float>> depth_buffers[3];
+
+		// Reference, visibility buffer, and tiled visibility buffer
+		rasterizers[1].visibility_buffer = true;
+		rasterizers[2].visibility_buffer = true;
+		rasterizers[2].tiled_rasterization = true;
+		rasterizers[2].tile_size = 16;
+
+		for (size_t i = 0; i < 3; i++)
+		{
+			render_targets[i] =
+				std::make_shared<cg::resource<cg::unsigned_color>>(width, height);
+			depth_buffers[i] = std::make_shared<cg::resource<float>>(width, height);
+			rasterizers[i].set_render_target(render_targets[i], depth_buffers[i]);
+			random_scene::bind(rasterizers[i], vertex_buffer, width, height);
+		}
+
+		WHEN("Clear and draw with and without the visibility buffer")
+		{
+			for (size_t i = 0; i < 3; i++)
+			{
+				rasterizers[i].clear_render_target({ 0, 0, 0 });
+				rasterizers[i].draw(vertex_buffer->get_number_of_elements(), 0);
+				rasterizers[i].resolve();
+			}
+
+			THEN("Images and depth buffers are equal")
+			{
+				for (size_t i = 1; i < 3; i++)
+				{
+					random_scene::require_equal(
+						*render_targets[0], *render_targets[i], width, height);
+					random_scene::require_equal(*depth_buffers[0], *depth_buffers[i], width, height);
+				}
+			}
+
+			THEN("Pixel shader runs once per covered pixel")
+			{
+				size_t covered_pixels = 0;
+				auto visibility_buffer = rasterizers[1].get_visibility_buffer();
+				for (size_t j = 0; j < depth_buffers[1]->get_number_of_elements(); j++)
+				{
+					bool covered = depth_buffers[1]->item(j) != FLT_MAX;
+					REQUIRE(
+						covered ==
+						(visibility_buffer->item(j) != rasterizer_type::empty_primitive_id));
+					if (covered)
+						covered_pixels++;
+				}
+
+				REQUIRE(rasterizers[1].get_statistics().shaded_fragments == covered_pixels);
+				REQUIRE(rasterizers[2].get_statistics().shaded_fragments == covered_pixels);
+				REQUIRE(rasterizers[0].get_statistics().shaded_fragments > covered_pixels);
+			}
+		}
+
+		WHEN("The triangles are drawn by several draw calls")
+		{
+			const size_t num_draws = 3;
+			const size_t draw_size = num_triangles / num_draws * 3;
+			for (size_t i = 0; i < 3; i++)
+			{
+				rasterizers[i].clear_render_target({ 0, 0, 0 });
+				for (size_t d = 0; d < num_draws; d++)
+					rasterizers[i].draw(draw_size, d * draw_size);
+			}
+
+			THEN("Pixels are shaded once by the resolve over all of the draws")
+			{
+				REQUIRE(rasterizers[1].get_statistics().shaded_fragments == 0);
+				for (size_t i = 0; i < 3; i++)
+					rasterizers[i].resolve();
+
+				size_t covered_pixels = 0;
+				bool all_draws = true;
+				auto visibility_buffer = rasterizers[1].get_visibility_buffer();
+				for (size_t j = 0; j < depth_buffers[1]->get_number_of_elements(); j++)
+				{
+					uint32_t id = visibility_buffer->item(j);
+					if (id == rasterizer_type::empty_primitive_id)
+						continue;
+					covered_pixels++;
+					all_draws &= (id >> rasterizer_type::visibility_primitive_bits) < num_draws;
+				}
+				REQUIRE(all_draws);
+				REQUIRE(rasterizers[1].get_statistics().shaded_fragments == covered_pixels);
+				REQUIRE(rasterizers[2].get_statistics().shaded_fragments == covered_pixels);
+
+				for (size_t i = 1; i < 3; i++)
+				{
+					random_scene::require_equal(
+						*render_targets[0], *render_targets[i], width, height);
+				}
+			}
+		}
+
+		WHEN("A draw without the visibility buffer follows the pending draws")
+		{
+			// The last triangle covers the others
+			const size_t last = vertex_buffer->get_number_of_elements() - 3;
+			vertex_buffer->item(last) = { -1.f, -1.f, 0.f };
+			vertex_buffer->item(last + 1) = { 3.f, -1.f, 0.f };
+			vertex_buffer->item(last + 2) = { -1.f, 3.f, 0.f };
+			for (size_t i = 0; i < 2; i++)
+			{
+				rasterizers[i].clear_render_target({ 0, 0, 0 });
+				rasterizers[i].draw(vertex_buffer->get_number_of_elements() - 3, 0);
+			}
+			rasterizers[1].visibility_buffer = false;
+			for (size_t i = 0; i < 2; i++)
+			{
+				rasterizers[i].draw(3, vertex_buffer->get_number_of_elements() - 3);
+				rasterizers[i].resolve();
+			}
+
+			THEN("The pending draws are resolved before it")
+			{
+				random_scene::require_equal(*render_targets[0], *render_targets[1], width, height);
+			}
+		}
+	}
+}